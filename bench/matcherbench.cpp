@@ -0,0 +1,62 @@
+#include "filenamematcher.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTextStream>
+
+/**
+ * Matches synthetic camera file paths against 1..64 include and exclude patterns
+ * and prints the matching cost per path, which should stay roughly flat.
+ */
+
+static const char * prefixes[] = {"IMG_", "DSC_", "DSCF", "PXL_", "P", "GOPR", "MVI_", "_MG_"};
+static const char * suffixes[] = {"", "_edited", "-1", "_HDR", "_burst"};
+static const char * extensions[] = {"jpg", "JPG", "png", "heic", "cr2", "xmp"};
+
+QStringList syntheticPaths(int count) {
+    QStringList paths;
+    paths.reserve(count);
+    for(int i = 0; i < count; ++i) {
+        paths << QString("/photos/%1/%2/%3%4%5.%6")
+            .arg(2010 + i % 12).arg(i % 97)
+            .arg(prefixes[i % 8]).arg(i, 4, 10, QChar('0'))
+            .arg(suffixes[i % 5]).arg(extensions[i % 6]);
+    }
+    return paths;
+}
+
+FileNameMatcher matcherWith(int patternCount) {
+    // half includes (camera prefixes), half excludes (sidecars, edits), all distinct
+    FileNameMatcher matcher;
+    for(int i = 0; i < patternCount; ++i) {
+        if(i % 2 == 0) {
+            matcher.addInclude(QString("%1%2*").arg(prefixes[(i / 2) % 8]).arg(i / 16), FileNameMatcher::Wildcard);
+        } else {
+            matcher.addExclude(QString("*%1%2.*").arg(suffixes[1 + (i / 2) % 4]).arg(i / 16), FileNameMatcher::Wildcard);
+        }
+    }
+    matcher.compile();
+    return matcher;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const int pathCount = app.arguments().count() > 1 ? app.arguments()[1].toInt() : 200000;
+    const QStringList paths = syntheticPaths(pathCount);
+    QTextStream out(stdout);
+    out << QString("%1 %2 %3\n").arg("patterns", 8).arg("ns/path", 10).arg("matched", 10);
+    for(int patternCount = 1; patternCount <= 64; patternCount *= 2) {
+        const FileNameMatcher matcher = matcherWith(patternCount);
+        QElapsedTimer timer;
+        timer.start();
+        int matched = 0;
+        for(const QString & path : paths) {
+            matched += matcher.matches(path) ? 1 : 0;
+        }
+        out << QString("%1 %2 %3\n").arg(patternCount, 8)
+            .arg(timer.nsecsElapsed() / (double) paths.count(), 10, 'f', 1).arg(matched, 10);
+    }
+    return 0;
+}
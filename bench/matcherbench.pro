@@ -0,0 +1,20 @@
+TEMPLATE = app
+
+QT -= gui
+
+CONFIG += c++11 console release
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# Microbenchmark of FileNameMatcher: ns/path for a growing number of --match/--exclude patterns.
+# Build and run standalone: qmake bench/matcherbench.pro && make && ./matcherbench [paths]
+
+INCLUDEPATH += $$PWD/../source
+
+SOURCES += \
+    $$PWD/matcherbench.cpp \
+    $$PWD/../source/filenamematcher.cpp
+
+HEADERS += \
+    $$PWD/../source/filenamematcher.h
@@ -1,6 +1,6 @@
 TEMPLATE = app
 
-QT -= gui
+QT += concurrent
 
 CONFIG += c++11 console
 CONFIG -= app_bundle
@@ -17,7 +17,14 @@ DEFINES += QT_DEPRECATED_WARNINGS
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    source/archivewriter.cpp \
+    source/bytebudgetencoder.cpp \
+    source/chunkedcopy.cpp \
+    source/dryrunplan.cpp \
+    source/filenamematcher.cpp \
+    source/imagehash.cpp \
     source/main.cpp \
+    source/manifest.cpp \
     source/verbosity.cpp
 
 
@@ -41,4 +48,11 @@ INCLUDEPATH += $$PWD/../pscom/include
 DEPENDPATH += $$PWD/../pscom/include
 
 HEADERS += \
+    source/archivewriter.h \
+    source/bytebudgetencoder.h \
+    source/chunkedcopy.h \
+    source/dryrunplan.h \
+    source/filenamematcher.h \
+    source/imagehash.h \
+    source/manifest.h \
     source/verbosity.h
@@ -0,0 +1,354 @@
+#include "archivewriter.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+
+#include <cstring>
+
+static const int tarBlockSize = 512;
+static const qint64 tarOctalSizeLimit = 077777777777LL; // 11 octal digits
+static const qint64 zip32Limit = 0xFFFFFFFFLL;
+static const int streamChunkSize = 1 << 20;
+
+namespace {
+    void putOctal(char * field, int width, qint64 value) {
+        // width includes the terminating NUL
+        const QByteArray digits = QByteArray::number(value, 8).rightJustified(width - 1, '0');
+        std::memcpy(field, digits.constData(), width - 1);
+        field[width - 1] = '\0';
+    }
+    void putTarSize(char * field, qint64 size) {
+        if(size <= tarOctalSizeLimit) {
+            putOctal(field, 12, size);
+            return;
+        }
+        // GNU base-256 encoding for files of 8 GiB and more
+        field[0] = (char) 0x80;
+        for(int i = 11; i > 0; --i, size >>= 8) {
+            field[i] = (char) (size & 0xFF);
+        }
+    }
+
+    void appendLE16(QByteArray & bytes, quint16 value) {
+        char buffer[2];
+        qToLittleEndian(value, (uchar *) buffer);
+        bytes.append(buffer, 2);
+    }
+    void appendLE32(QByteArray & bytes, quint32 value) {
+        char buffer[4];
+        qToLittleEndian(value, (uchar *) buffer);
+        bytes.append(buffer, 4);
+    }
+    void appendLE64(QByteArray & bytes, quint64 value) {
+        char buffer[8];
+        qToLittleEndian(value, (uchar *) buffer);
+        bytes.append(buffer, 8);
+    }
+
+    void toDosDateTime(const QDateTime & dateTime, quint16 & time, quint16 & date) {
+        const QDateTime local = dateTime.isValid() && dateTime.date().year() >= 1980
+            ? dateTime.toLocalTime() : QDateTime(QDate(1980, 1, 1), QTime(0, 0));
+        time = (quint16) ((local.time().hour() << 11) | (local.time().minute() << 5) | (local.time().second() / 2));
+        date = (quint16) (((local.date().year() - 1980) << 9) | (local.date().month() << 5) | local.date().day());
+    }
+}
+
+bool ArchiveWriter::formatFromPath(const QString & path, Format & format)
+{
+    if(path == "-" || path.endsWith(".tar", Qt::CaseInsensitive)) {
+        format = Tar;
+        return true;
+    }
+    if(path.endsWith(".zip", Qt::CaseInsensitive)) {
+        format = Zip;
+        return true;
+    }
+    return false;
+}
+
+ArchiveWriter::ArchiveWriter(QIODevice * device, Format format)
+    : device(device), format(format)
+{
+}
+
+bool ArchiveWriter::addFile(const QString & memberName, const QString & filepath, const QByteArray * data)
+{
+    const QByteArray name = QString(memberName).replace('\\', '/').toUtf8();
+    return format == Tar
+        ? addTarMember(name, filepath, data)
+        : addZipMember(name, filepath, data);
+}
+
+bool ArchiveWriter::finish()
+{
+    if(format == Zip) {
+        return finishZip();
+    }
+    // end of archive: two empty blocks
+    return writePadding(2 * tarBlockSize);
+}
+
+qint64 ArchiveWriter::bytesWritten() const
+{
+    return offset;
+}
+
+const QString & ArchiveWriter::errorString() const
+{
+    return error;
+}
+
+quint32 ArchiveWriter::crc32(const char * data, qint64 size, quint32 crc)
+{
+    static const QVector<quint32> table = [] {
+        QVector<quint32> table(256);
+        for(quint32 i = 0; i < 256; ++i) {
+            quint32 c = i;
+            for(int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        return table;
+    }();
+    crc = ~crc;
+    for(qint64 i = 0; i < size; ++i) {
+        crc = table[(crc ^ (uchar) data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+bool ArchiveWriter::write(const QByteArray & bytes)
+{
+    return write(bytes.constData(), bytes.size());
+}
+
+bool ArchiveWriter::write(const char * data, qint64 size)
+{
+    if(device->write(data, size) != size) {
+        error = QString("Writing archive failed: %1").arg(device->errorString());
+        return false;
+    }
+    offset += size;
+    return true;
+}
+
+bool ArchiveWriter::writePadding(qint64 size)
+{
+    return size <= 0 || write(QByteArray((int) size, '\0'));
+}
+
+bool ArchiveWriter::openFile(QFile & file)
+{
+    // before any header is written, so a failing file leaves the archive intact
+    if(!file.open(QIODevice::ReadOnly)) {
+        error = QString("Reading file failed \"%1\"").arg(file.fileName());
+        return false;
+    }
+    return true;
+}
+
+bool ArchiveWriter::streamFile(QFile & file, qint64 size, quint32 * crc)
+{
+    QByteArray buffer(streamChunkSize, Qt::Uninitialized);
+    qint64 remaining = size;
+    while(remaining > 0) {
+        const qint64 read = file.read(buffer.data(), qMin<qint64>(buffer.size(), remaining));
+        if(read <= 0) {
+            // the header already promised size bytes
+            error = QString("File changed while archiving \"%1\"").arg(file.fileName());
+            return false;
+        }
+        if(crc) *crc = crc32(buffer.constData(), read, *crc);
+        if(!write(buffer.constData(), read)) {
+            return false;
+        }
+        remaining -= read;
+    }
+    return true;
+}
+
+bool ArchiveWriter::writeTarHeader(const QByteArray & name, qint64 size, const QDateTime & modified, char type)
+{
+    char header[tarBlockSize];
+    std::memset(header, 0, sizeof(header));
+    std::memcpy(header, name.constData(), qMin(name.size(), 100));
+    putOctal(header + 100, 8, type == 'L' ? 0 : 0644);
+    putOctal(header + 108, 8, 0);
+    putOctal(header + 116, 8, 0);
+    putTarSize(header + 124, size);
+    putOctal(header + 136, 12, modified.isValid() ? modified.toMSecsSinceEpoch() / 1000 : 0);
+    header[156] = type;
+    std::memcpy(header + 257, "ustar", 6);
+    std::memcpy(header + 263, "00", 2);
+
+    std::memset(header + 148, ' ', 8);
+    unsigned int checksum = 0;
+    for(int i = 0; i < tarBlockSize; ++i) {
+        checksum += (uchar) header[i];
+    }
+    putOctal(header + 148, 7, checksum);
+    header[155] = ' ';
+    return write(header, tarBlockSize);
+}
+
+bool ArchiveWriter::addTarMember(const QByteArray & name, const QString & filepath, const QByteArray * data)
+{
+    const QFileInfo info(filepath);
+    const qint64 size = data ? data->size() : info.size();
+    QFile file(filepath);
+    if(!data && !openFile(file)) {
+        return false;
+    }
+    if(name.size() > 100) {
+        // GNU long name record preceding the actual header
+        const QByteArray longName = name + '\0';
+        if(!writeTarHeader("././@LongLink", longName.size(), QDateTime(), 'L')
+            || !write(longName)
+            || !writePadding((tarBlockSize - longName.size() % tarBlockSize) % tarBlockSize)) {
+            return false;
+        }
+    }
+    if(!writeTarHeader(name, size, info.lastModified(), '0')) {
+        return false;
+    }
+    if(data ? !write(*data) : !streamFile(file, size, nullptr)) {
+        return false;
+    }
+    return writePadding((tarBlockSize - size % tarBlockSize) % tarBlockSize);
+}
+
+bool ArchiveWriter::addZipMember(const QByteArray & name, const QString & filepath, const QByteArray * data)
+{
+    const QFileInfo info(filepath);
+    QFile file(filepath);
+    if(!data && !openFile(file)) {
+        return false;
+    }
+    ZipEntry entry;
+    entry.name = name;
+    entry.size = data ? data->size() : info.size();
+    entry.offset = offset;
+    // prefetched data gets its crc upfront, streamed files get a trailing data descriptor
+    entry.crc = data ? crc32(data->constData(), data->size()) : 0;
+    entry.flags = 0x0800 | (data ? 0 : 0x0008); // utf-8 names, data descriptor
+    toDosDateTime(info.lastModified(), entry.dosTime, entry.dosDate);
+    const bool zip64 = entry.size >= zip32Limit;
+
+    QByteArray header;
+    appendLE32(header, 0x04034b50);
+    appendLE16(header, zip64 ? 45 : 20);
+    appendLE16(header, entry.flags);
+    appendLE16(header, 0); // stored
+    appendLE16(header, entry.dosTime);
+    appendLE16(header, entry.dosDate);
+    appendLE32(header, entry.crc);
+    appendLE32(header, zip64 ? 0xFFFFFFFFu : (data ? (quint32) entry.size : 0));
+    appendLE32(header, zip64 ? 0xFFFFFFFFu : (data ? (quint32) entry.size : 0));
+    appendLE16(header, (quint16) name.size());
+    appendLE16(header, zip64 ? 20 : 0);
+    header.append(name);
+    if(zip64) {
+        appendLE16(header, 0x0001);
+        appendLE16(header, 16);
+        appendLE64(header, data ? entry.size : 0);
+        appendLE64(header, data ? entry.size : 0);
+    }
+    if(!write(header)) {
+        return false;
+    }
+    if(data) {
+        if(!write(*data)) return false;
+    } else {
+        if(!streamFile(file, entry.size, &entry.crc)) return false;
+        QByteArray descriptor;
+        appendLE32(descriptor, 0x08074b50);
+        appendLE32(descriptor, entry.crc);
+        if(zip64) {
+            appendLE64(descriptor, entry.size);
+            appendLE64(descriptor, entry.size);
+        } else {
+            appendLE32(descriptor, (quint32) entry.size);
+            appendLE32(descriptor, (quint32) entry.size);
+        }
+        if(!write(descriptor)) return false;
+    }
+    zipEntries << entry;
+    return true;
+}
+
+bool ArchiveWriter::finishZip()
+{
+    const qint64 directoryOffset = offset;
+    for(const ZipEntry & entry : zipEntries) {
+        const bool sizeOverflow = entry.size >= zip32Limit;
+        const bool offsetOverflow = entry.offset >= zip32Limit;
+        QByteArray extra;
+        if(sizeOverflow) {
+            appendLE64(extra, entry.size);
+            appendLE64(extra, entry.size);
+        }
+        if(offsetOverflow) {
+            appendLE64(extra, entry.offset);
+        }
+        if(!extra.isEmpty()) {
+            QByteArray field;
+            appendLE16(field, 0x0001);
+            appendLE16(field, (quint16) extra.size());
+            extra.prepend(field);
+        }
+        QByteArray record;
+        appendLE32(record, 0x02014b50);
+        appendLE16(record, 45);
+        appendLE16(record, extra.isEmpty() ? 20 : 45);
+        appendLE16(record, entry.flags);
+        appendLE16(record, 0);
+        appendLE16(record, entry.dosTime);
+        appendLE16(record, entry.dosDate);
+        appendLE32(record, entry.crc);
+        appendLE32(record, sizeOverflow ? 0xFFFFFFFFu : (quint32) entry.size);
+        appendLE32(record, sizeOverflow ? 0xFFFFFFFFu : (quint32) entry.size);
+        appendLE16(record, (quint16) entry.name.size());
+        appendLE16(record, (quint16) extra.size());
+        appendLE16(record, 0); // comment
+        appendLE16(record, 0); // disk
+        appendLE16(record, 0); // internal attributes
+        appendLE32(record, 0); // external attributes
+        appendLE32(record, offsetOverflow ? 0xFFFFFFFFu : (quint32) entry.offset);
+        record.append(entry.name);
+        record.append(extra);
+        if(!write(record)) {
+            return false;
+        }
+    }
+    const qint64 directorySize = offset - directoryOffset;
+    const qint64 count = zipEntries.count();
+    QByteArray end;
+    if(count >= 0xFFFF || directoryOffset >= zip32Limit || directorySize >= zip32Limit) {
+        const qint64 zip64EndOffset = offset;
+        appendLE32(end, 0x06064b50);
+        appendLE64(end, 44);
+        appendLE16(end, 45);
+        appendLE16(end, 45);
+        appendLE32(end, 0);
+        appendLE32(end, 0);
+        appendLE64(end, count);
+        appendLE64(end, count);
+        appendLE64(end, directorySize);
+        appendLE64(end, directoryOffset);
+        appendLE32(end, 0x07064b50);
+        appendLE32(end, 0);
+        appendLE64(end, zip64EndOffset);
+        appendLE32(end, 1);
+    }
+    appendLE32(end, 0x06054b50);
+    appendLE16(end, 0);
+    appendLE16(end, 0);
+    appendLE16(end, (quint16) qMin<qint64>(count, 0xFFFF));
+    appendLE16(end, (quint16) qMin<qint64>(count, 0xFFFF));
+    appendLE32(end, (quint32) qMin(directorySize, zip32Limit));
+    appendLE32(end, (quint32) qMin(directoryOffset, zip32Limit));
+    appendLE16(end, 0);
+    return write(end);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFile>
+#include <QIODevice>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief ArchiveWriter - writes files sequentially into a tar (ustar with GNU long names)
+ * or an uncompressed zip (store, zip64 when needed) stream. The device is never seeked,
+ * so it may be a pipe or stdout.
+ */
+class ArchiveWriter {
+    public:
+        enum Format { Tar, Zip };
+
+        static bool formatFromPath(const QString & path, Format & format);
+
+        ArchiveWriter(QIODevice * device, Format format);
+
+        /**
+         * @brief adds the file as memberName, taking its content from data if given
+         * and streaming it from disk otherwise
+         */
+        bool addFile(const QString & memberName, const QString & filepath, const QByteArray * data = nullptr);
+        bool finish();
+
+        qint64 bytesWritten() const;
+        const QString & errorString() const;
+
+        static quint32 crc32(const char * data, qint64 size, quint32 crc = 0);
+
+    private:
+        struct ZipEntry {
+            QByteArray name;
+            quint32 crc;
+            qint64 size;
+            qint64 offset;
+            quint16 dosTime, dosDate;
+            quint16 flags;
+        };
+
+        bool write(const QByteArray & bytes);
+        bool write(const char * data, qint64 size);
+        bool writePadding(qint64 size);
+        bool openFile(QFile & file);
+        bool streamFile(QFile & file, qint64 size, quint32 * crc);
+
+        bool writeTarHeader(const QByteArray & name, qint64 size, const QDateTime & modified, char type);
+        bool addTarMember(const QByteArray & name, const QString & filepath, const QByteArray * data);
+        bool addZipMember(const QByteArray & name, const QString & filepath, const QByteArray * data);
+        bool finishZip();
+
+        QIODevice * device;
+        Format format;
+        qint64 offset = 0;
+        QVector<ZipEntry> zipEntries;
+        QString error;
+};
@@ -0,0 +1,100 @@
+#include "bytebudgetencoder.h"
+
+#include <QRegularExpression>
+
+#include <cmath>
+
+static const int maxDownscaleSteps = 8;
+static const int minDimension = 16;
+
+ByteBudgetEncoder::ByteBudgetEncoder(qint64 maxBytes, const QByteArray & format, int maxQuality, int minQuality)
+    : maxBytes(maxBytes), maxQuality(maxQuality), minQuality(qMin(minQuality, maxQuality))
+{
+    buffer.open(QIODevice::ReadWrite);
+    writer.setDevice(&buffer);
+    writer.setFormat(format);
+}
+
+bool ByteBudgetEncoder::encode(QImage image, Result & result)
+{
+    result = Result();
+    error.clear();
+    for(int step = 0; step <= maxDownscaleSteps; ++step) {
+        qint64 smallestSize = -1;
+        switch(searchQuality(image, result, smallestSize)) {
+        case Fits:
+            result.size = image.size();
+            return true;
+        case Failed:
+            error = QString("encoding failed: %1").arg(writer.errorString());
+            return false;
+        case TooLarge:
+            break;
+        }
+        // pixel count roughly scales with the encoded size, aim a bit below the budget
+        const double factor = qMin(0.9, std::sqrt((double) maxBytes / smallestSize) * 0.95);
+        const QSize scaled = image.size() * factor;
+        if(scaled.width() < minDimension || scaled.height() < minDimension) {
+            break;
+        }
+        image = image.scaled(scaled, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    error = "budget too small";
+    return false;
+}
+
+const QString & ByteBudgetEncoder::errorString() const
+{
+    return error;
+}
+
+bool ByteBudgetEncoder::parseByteSize(const QString & text, qint64 & bytes)
+{
+    static const QRegularExpression pattern("^\\s*(\\d+(?:\\.\\d+)?)\\s*([kmg]?)i?b?\\s*$",
+        QRegularExpression::CaseInsensitiveOption);
+    const auto match = pattern.match(text);
+    if(!match.hasMatch()) {
+        return false;
+    }
+    const QString unit = match.captured(2).toLower();
+    const int shift = unit == "k" ? 10 : unit == "m" ? 20 : unit == "g" ? 30 : 0;
+    bytes = (qint64) (match.captured(1).toDouble() * (1LL << shift));
+    return bytes > 0;
+}
+
+qint64 ByteBudgetEncoder::encodedSize(const QImage & image, int quality)
+{
+    // overwrite the previous attempt in place, the buffer keeps its capacity
+    buffer.seek(0);
+    writer.setQuality(quality);
+    if(!writer.write(image)) {
+        return -1;
+    }
+    return buffer.pos();
+}
+
+ByteBudgetEncoder::Search ByteBudgetEncoder::searchQuality(const QImage & image, Result & result, qint64 & smallestSize)
+{
+    int low = minQuality, high = maxQuality;
+    bool found = false;
+    while(low <= high) {
+        const int quality = (low + high) / 2;
+        const qint64 size = encodedSize(image, quality);
+        ++result.attempts;
+        if(size < 0) {
+            return Failed;
+        }
+        if(size <= maxBytes) {
+            result.data = buffer.data().left((int) size);
+            result.quality = quality;
+            found = true;
+            low = quality + 1;
+        } else {
+            high = quality - 1;
+        }
+        if(smallestSize < 0 || size < smallestSize) {
+            smallestSize = size;
+        }
+    }
+    return found ? Fits : TooLarge;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QBuffer>
+#include <QByteArray>
+#include <QImage>
+#include <QImageWriter>
+
+/**
+ * @brief ByteBudgetEncoder - encodes an image into memory, binary-searching the highest quality
+ * that fits the byte budget and downscaling if even the lowest quality does not fit.
+ * One buffer and writer are reused for every attempt.
+ */
+class ByteBudgetEncoder {
+    public:
+        struct Result {
+            QByteArray data;
+            int quality = -1;
+            QSize size;
+            int attempts = 0;
+        };
+
+        ByteBudgetEncoder(qint64 maxBytes, const QByteArray & format, int maxQuality = 95, int minQuality = 10);
+
+        bool encode(QImage image, Result & result); // false if nothing fits or encoding fails, see errorString()
+        const QString & errorString() const;
+
+        static bool parseByteSize(const QString & text, qint64 & bytes); // "500k", "2M", "1048576"
+
+    private:
+        enum Search { Fits, TooLarge, Failed };
+
+        qint64 encodedSize(const QImage & image, int quality);
+        Search searchQuality(const QImage & image, Result & result, qint64 & smallestSize);
+
+        const qint64 maxBytes;
+        const int maxQuality, minQuality;
+        QBuffer buffer;
+        QImageWriter writer;
+        QString error;
+};
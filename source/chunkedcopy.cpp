@@ -0,0 +1,166 @@
+#include "chunkedcopy.h"
+
+#include <QFile>
+#include <QVector>
+#include <QtConcurrent>
+
+#include <atomic>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(Q_OS_LINUX) && defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#define PSCOM_HAS_COPY_FILE_RANGE
+#endif
+
+static const int bufferSize = 1 << 20;
+
+#ifdef Q_OS_UNIX
+namespace {
+    struct Range {
+        qint64 offset, length;
+    };
+
+    // errno is thread-local, so the range copies return it instead, 0 on success
+    int copyRangeBuffered(int source, int target, qint64 offset, qint64 length) {
+        QByteArray buffer(bufferSize, Qt::Uninitialized);
+        while(length > 0) {
+            const ssize_t read = ::pread(source, buffer.data(), (size_t) qMin<qint64>(buffer.size(), length), offset);
+            if(read < 0 && errno == EINTR) continue;
+            if(read < 0) return errno;
+            if(read == 0) return EIO; // source shrank while copying
+            for(ssize_t done = 0; done < read;) {
+                const ssize_t written = ::pwrite(target, buffer.constData() + done, (size_t) (read - done), offset + done);
+                if(written < 0 && errno == EINTR) continue;
+                if(written < 0) return errno;
+                if(written == 0) return EIO;
+                done += written;
+            }
+            offset += read;
+            length -= read;
+        }
+        return 0;
+    }
+
+    int copyRange(int source, int target, const Range & range) {
+#ifdef PSCOM_HAS_COPY_FILE_RANGE
+        // in-kernel copy, may even be offloaded to the filesystem or device
+        loff_t sourceOffset = range.offset, targetOffset = range.offset;
+        qint64 remaining = range.length;
+        while(remaining > 0) {
+            const ssize_t copied = ::copy_file_range(source, &sourceOffset, target, &targetOffset, (size_t) remaining, 0);
+            if(copied < 0 && errno == EINTR) continue;
+            if(copied <= 0) {
+                // e.g. EXDEV on older kernels or unsupported filesystems
+                return copyRangeBuffered(source, target, sourceOffset, remaining);
+            }
+            remaining -= copied;
+        }
+        return 0;
+#else
+        return copyRangeBuffered(source, target, range.offset, range.length);
+#endif
+    }
+
+    bool preallocate(int file, qint64 size) {
+#ifdef Q_OS_LINUX
+        if(::fallocate(file, 0, 0, size) == 0) {
+            return true;
+        }
+#endif
+        // filesystems without fallocate support still get their final size upfront
+        return ::ftruncate(file, size) == 0;
+    }
+}
+#endif
+
+ChunkedCopy::ChunkedCopy(qint64 chunkSize)
+    : chunkSize(chunkSize)
+{
+}
+
+bool ChunkedCopy::copy(const QString & sourceFilepath, const QString & targetFilepath)
+{
+#ifdef Q_OS_UNIX
+    const QByteArray sourcePath = QFile::encodeName(sourceFilepath);
+    const QByteArray targetPath = QFile::encodeName(targetFilepath);
+    const QByteArray partialPath = targetPath + ".pscom-part";
+
+    const int source = ::open(sourcePath.constData(), O_RDONLY);
+    if(source < 0) {
+        error = QString("Reading file failed \"%1\": %2").arg(sourceFilepath).arg(std::strerror(errno));
+        return false;
+    }
+    struct stat info;
+    if(::fstat(source, &info) != 0) {
+        error = QString("Reading file failed \"%1\": %2").arg(sourceFilepath).arg(std::strerror(errno));
+        ::close(source);
+        return false;
+    }
+    const int target = ::open(partialPath.constData(), O_WRONLY | O_CREAT | O_TRUNC, info.st_mode & 0777);
+    if(target < 0) {
+        error = QString("Writing file failed \"%1\": %2").arg(targetFilepath).arg(std::strerror(errno));
+        ::close(source);
+        return false;
+    }
+    const auto fail = [&](const QString & message, int errorNumber) {
+        error = QString("%1 \"%2\": %3").arg(message).arg(targetFilepath).arg(std::strerror(errorNumber));
+        ::close(source);
+        ::close(target);
+        ::unlink(partialPath.constData());
+        return false;
+    };
+    if(!preallocate(target, info.st_size)) {
+        return fail("Allocating file failed", errno);
+    }
+
+    QVector<Range> ranges;
+    for(qint64 offset = 0; offset < info.st_size; offset += chunkSize) {
+        ranges << Range { offset, qMin(chunkSize, (qint64) info.st_size - offset) };
+    }
+    std::atomic<int> failedErrno(0); // first failure of any worker
+    QtConcurrent::blockingMap(ranges, [&](const Range & range) {
+        if(failedErrno != 0) return;
+        const int errorNumber = copyRange(source, target, range);
+        int none = 0;
+        if(errorNumber != 0) failedErrno.compare_exchange_strong(none, errorNumber);
+    });
+    if(failedErrno != 0) {
+        return fail("Copying file failed", failedErrno);
+    }
+    if(::fsync(target) != 0) {
+        return fail("Writing file failed", errno);
+    }
+    ::close(source);
+    if(::close(target) != 0 || ::rename(partialPath.constData(), targetPath.constData()) != 0) {
+        error = QString("Writing file failed \"%1\": %2").arg(targetFilepath).arg(std::strerror(errno));
+        ::unlink(partialPath.constData());
+        return false;
+    }
+    return true;
+#else
+    Q_UNUSED(sourceFilepath);
+    Q_UNUSED(targetFilepath);
+    error = "Chunked copies are not supported on this platform";
+    return false;
+#endif
+}
+
+const QString & ChunkedCopy::errorString() const
+{
+    return error;
+}
+
+bool ChunkedCopy::isSupported()
+{
+#ifdef Q_OS_UNIX
+    return true;
+#else
+    return false;
+#endif
+}
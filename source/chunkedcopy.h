@@ -0,0 +1,22 @@
+#pragma once
+
+#include <QString>
+
+/**
+ * @brief ChunkedCopy - copies one large file with several workers, each transferring its own
+ * byte ranges into a preallocated temporary target, which is renamed into place only after
+ * every range succeeded. Only available on unix, see isSupported().
+ */
+class ChunkedCopy {
+    public:
+        explicit ChunkedCopy(qint64 chunkSize = 16 << 20);
+
+        bool copy(const QString & sourceFilepath, const QString & targetFilepath);
+        const QString & errorString() const;
+
+        static bool isSupported();
+
+    private:
+        const qint64 chunkSize;
+        QString error;
+};
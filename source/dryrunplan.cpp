@@ -0,0 +1,393 @@
+#include "dryrunplan.h"
+
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QStandardPaths>
+#include <QStorageInfo>
+#include <QTemporaryFile>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const int calibrationChunkSize = 1 << 20;
+static const int calibrationRenames = 8;
+
+namespace {
+    void evictFromCache(QFile & file) {
+#if defined(Q_OS_UNIX) && defined(POSIX_FADV_DONTNEED)
+        // otherwise recently listed files are measured at memory speed
+        ::posix_fadvise(file.handle(), 0, 0, POSIX_FADV_DONTNEED);
+#else
+        Q_UNUSED(file);
+#endif
+    }
+    void syncToDevice(QFile & file) {
+        file.flush();
+#ifdef Q_OS_UNIX
+        ::fsync(file.handle());
+#endif
+    }
+    double seconds(const QElapsedTimer & timer) {
+        return qMax<qint64>(timer.nsecsElapsed(), 1) / 1e9;
+    }
+    double perSecond(qint64 bytes, double throughput) {
+        return throughput > 0 ? bytes / throughput : 0;
+    }
+}
+
+DryRunPlan::Kind DryRunPlan::record(Operation operation, const QString & sourceFilepath, const QString & targetFilepath)
+{
+    QMutexLocker lock(&mutex);
+    Step step;
+    step.source = sourceFilepath;
+    step.target = targetFilepath.isEmpty() ? sourceFilepath : targetFilepath;
+    step.bytes = QFileInfo(sourceFilepath).size();
+    step.sourceDevice = deviceOf(step.source);
+    step.targetDevice = deviceOf(step.target);
+    switch(operation) {
+    case CopyOperation:
+        step.kind = Copy;
+        break;
+    case MoveOperation:
+        step.kind = step.sourceDevice == step.targetDevice ? Rename : CrossDeviceMove;
+        break;
+    case TransformOperation:
+        step.kind = Transform;
+        break;
+    case LinkOperation:
+        step.kind = Link;
+        break;
+    case RemoveOperation:
+        step.kind = Remove;
+        break;
+    }
+    DeviceStats & source = devices[step.sourceDevice];
+    DeviceStats & target = devices[step.targetDevice];
+    if(step.kind == Copy || step.kind == CrossDeviceMove || step.kind == Transform) {
+        // transformed images are assumed to keep roughly their size
+        source.bytesRead += step.bytes;
+        target.bytesWritten += step.bytes;
+    }
+    steps << step;
+    return step.kind;
+}
+
+bool DryRunPlan::isEmpty() const
+{
+    QMutexLocker lock(&mutex);
+    return steps.isEmpty();
+}
+
+void DryRunPlan::setPerFileOverhead(double seconds)
+{
+    perFileOverhead = seconds;
+}
+
+void DryRunPlan::addOverheadFiles(int count)
+{
+    QMutexLocker lock(&mutex);
+    overheadFiles += count;
+}
+
+void DryRunPlan::calibrate(int sampleCount, qint64 sampleBytes)
+{
+    QMutexLocker lock(&mutex);
+    QVector<const Step *> dataSteps;
+    bool hasRenames = false;
+    const Step * transformSample = nullptr;
+    for(const Step & step : steps) {
+        if(step.bytes > 0 && (step.kind == Copy || step.kind == CrossDeviceMove || step.kind == Transform)) {
+            dataSteps << &step;
+        }
+        if(step.kind == Transform && !transformSample) transformSample = &step;
+        hasRenames |= step.kind != Copy && step.kind != Transform;
+    }
+
+    // read throughput per source device on evenly spaced sample files
+    const int samples = qMin(sampleCount, dataSteps.count());
+    const qint64 bytesPerSample = sampleBytes / qMax(1, sampleCount);
+    QMap<QString, QPair<qint64, double>> readSamples;
+    QByteArray buffer(calibrationChunkSize, Qt::Uninitialized);
+    for(int i = 0; i < samples; ++i) {
+        const Step * step = dataSteps[i * dataSteps.count() / samples];
+        QFile file(step->source);
+        if(!file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        evictFromCache(file);
+        QElapsedTimer timer;
+        timer.start();
+        qint64 total = 0, read;
+        while(total < bytesPerSample && (read = file.read(buffer.data(), buffer.size())) > 0) {
+            total += read;
+        }
+        auto & sample = readSamples[step->sourceDevice];
+        sample.first += total;
+        sample.second += seconds(timer);
+        ++sampledFiles;
+        sampledBytes += total;
+    }
+    for(auto i = readSamples.constBegin(); i != readSamples.constEnd(); ++i) {
+        devices[i.key()].readThroughput = i.value().first / i.value().second;
+    }
+
+    // writes only ever go to the temp location, every other device gets an assumed speed
+    const QString scratchDirectory = QStandardPaths::writableLocation(QStandardPaths::TempLocation);
+    const QString scratchDevice = deviceOf(scratchDirectory);
+    const auto scratch = devices.find(scratchDevice);
+    const bool probeWrites = scratch != devices.end() && scratch->bytesWritten > 0;
+    bool hasWrites = false;
+    for(const DeviceStats & device : devices) {
+        hasWrites |= device.bytesWritten > 0;
+    }
+    double scratchWriteThroughput = 0;
+    if(hasWrites || hasRenames) {
+        QTemporaryFile file(scratchDirectory + "/pscom-calibration-XXXXXX");
+        if(file.open()) {
+            QElapsedTimer timer;
+            // also measured as the fallback for devices which are written to but not probed
+            const qint64 bytes = probeWrites
+                ? qMin(sampleBytes, qMax<qint64>(scratch->bytesWritten, calibrationChunkSize))
+                : calibrationChunkSize * 4;
+            timer.start();
+            for(qint64 written = 0; written < bytes; written += buffer.size()) {
+                file.write(buffer);
+            }
+            syncToDevice(file);
+            scratchWriteThroughput = bytes / seconds(timer);
+            if(probeWrites) {
+                scratch->writeThroughput = scratchWriteThroughput;
+            }
+            file.close();
+            if(hasRenames) {
+                const QString name = file.fileName(), renamed = name + ".renamed";
+                bool renamedBack = true;
+                int renames = 0;
+                timer.restart();
+                while(renames < calibrationRenames && renamedBack) {
+                    if(!QFile::rename(name, renamed)) break;
+                    renamedBack = QFile::rename(renamed, name);
+                    renames += 2;
+                }
+                if(!renamedBack) {
+                    // the temporary file only removes itself under its original name
+                    QFile::remove(renamed);
+                } else if(renames == calibrationRenames) {
+                    renameLatency = seconds(timer) / calibrationRenames;
+                }
+            }
+        }
+    }
+
+    assumeUncalibrated(scratchWriteThroughput);
+
+    // in-memory decode and encode of one sample image
+    if(transformSample) {
+        QElapsedTimer timer;
+        timer.start();
+        const QImage image = QImageReader(transformSample->source).read();
+        if(!image.isNull()) {
+            QBuffer encoded;
+            encoded.open(QIODevice::WriteOnly);
+            QImageWriter(&encoded, "jpg").write(image);
+            transformThroughput = transformSample->bytes / seconds(timer);
+        }
+    }
+}
+
+QStringList DryRunPlan::report() const
+{
+    QMutexLocker lock(&mutex);
+    QMap<Kind, QPair<int, qint64>> kinds;
+    qint64 totalBytes = 0;
+    for(const Step & step : steps) {
+        auto & kind = kinds[step.kind];
+        ++kind.first;
+        kind.second += step.bytes;
+        if(step.kind != Rename && step.kind != Link && step.kind != Remove) totalBytes += step.bytes;
+    }
+    QStringList lines;
+    lines << QString("Dry run: %1 operation(s) moving %2 of data").arg(steps.count()).arg(formatBytes(totalBytes));
+    for(auto i = kinds.constBegin(); i != kinds.constEnd(); ++i) {
+        lines << QString("  %1: %2 file(s), %3").arg(kindName(i.key()), -20)
+            .arg(i.value().first).arg(formatBytes(i.value().second));
+    }
+    const auto throughput = [](double value, bool assumed = false) {
+        return value > 0
+            ? QString("%1/s%2").arg(formatBytes((qint64) value)).arg(assumed ? " assumed" : "")
+            : QString("uncalibrated");
+    };
+    for(auto i = devices.constBegin(); i != devices.constEnd(); ++i) {
+        const DeviceStats & device = i.value();
+        if(device.bytesRead == 0 && device.bytesWritten == 0) {
+            continue;
+        }
+        lines << QString("  %1: read %2 (%3), write %4 (%5), ~%6").arg(i.key())
+            .arg(formatBytes(device.bytesRead)).arg(throughput(device.readThroughput, device.readAssumed))
+            .arg(formatBytes(device.bytesWritten)).arg(throughput(device.writeThroughput, device.writeAssumed))
+            .arg(formatDuration(perSecond(device.bytesRead, device.readThroughput)
+                + perSecond(device.bytesWritten, device.writeThroughput)));
+    }
+    lines << QString("Calibrated on %1 sample file(s) (%2), rename %3 (temp location, assumed for every device), transform %4")
+        .arg(sampledFiles).arg(formatBytes(sampledBytes))
+        .arg(renameLatency > 0 ? QString("%1 ms").arg(renameLatency * 1000, 0, 'f', 2) : QString("uncalibrated"))
+        .arg(throughput(transformThroughput));
+    const QStringList uncalibrated = uncalibratedDevices();
+    if(uncalibrated.isEmpty()) {
+        lines << QString("Estimated duration: %1").arg(formatDuration(estimateSeconds()));
+    } else {
+        lines << QString("Estimated duration: at least %1, leaving out %2")
+            .arg(formatDuration(estimateSeconds())).arg(uncalibrated.join(", "));
+    }
+    return lines;
+}
+
+QString DryRunPlan::kindName(Kind kind)
+{
+    switch(kind) {
+    case Rename: return "same-device rename";
+    case Copy: return "copy";
+    case CrossDeviceMove: return "cross-device copy";
+    case Transform: return "transform";
+    case Link: return "link";
+    case Remove: return "remove";
+    }
+    return QString();
+}
+
+QString DryRunPlan::formatBytes(qint64 bytes)
+{
+    static const char * units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    double value = bytes;
+    int unit = 0;
+    while(value >= 1024 && unit < 4) {
+        value /= 1024;
+        ++unit;
+    }
+    return unit == 0
+        ? QString("%1 B").arg(bytes)
+        : QString("%L1 %2").arg(value, 0, 'f', 1).arg(units[unit]);
+}
+
+QString DryRunPlan::formatDuration(double seconds)
+{
+    const qint64 whole = (qint64) seconds;
+    if(whole >= 3600) {
+        return QString("%1h %2m").arg(whole / 3600).arg(whole % 3600 / 60, 2, 10, QChar('0'));
+    }
+    if(whole >= 60) {
+        return QString("%1m %2s").arg(whole / 60).arg(whole % 60, 2, 10, QChar('0'));
+    }
+    return QString("%1s").arg(seconds, 0, 'f', 1);
+}
+
+QString DryRunPlan::deviceOf(const QString & path)
+{
+    const QString directory = existingDirectory(path);
+    const auto cached = deviceCache.constFind(directory);
+    if(cached != deviceCache.constEnd()) {
+        return cached.value();
+    }
+    const QStorageInfo storage(directory);
+    const QString device = storage.isValid()
+        ? QString("%1 (%2)").arg(QString::fromLocal8Bit(storage.device())).arg(storage.rootPath())
+        : QString("unknown device");
+    deviceCache.insert(directory, device);
+    return device;
+}
+
+QString DryRunPlan::existingDirectory(const QString & path)
+{
+    // targets of a dry run usually do not exist yet
+    const QFileInfo info(path);
+    QString directory = info.isDir() ? info.absoluteFilePath() : info.absolutePath();
+    while(!QFileInfo(directory).isDir()) {
+        const QString parent = QFileInfo(directory).absolutePath();
+        if(parent == directory) break;
+        directory = parent;
+    }
+    return directory;
+}
+
+void DryRunPlan::assumeUncalibrated(double scratchWriteThroughput)
+{
+    // the slowest measured read stands in for devices none of the samples were on
+    double slowestRead = 0;
+    for(const DeviceStats & device : devices) {
+        if(device.readThroughput > 0 && (slowestRead == 0 || device.readThroughput < slowestRead)) {
+            slowestRead = device.readThroughput;
+        }
+    }
+    for(DeviceStats & device : devices) {
+        if(device.bytesRead > 0 && device.readThroughput == 0 && slowestRead > 0) {
+            device.readThroughput = slowestRead;
+            device.readAssumed = true;
+        }
+        if(device.bytesWritten > 0 && device.writeThroughput == 0) {
+            // writes are rarely faster than reads on the same device
+            device.writeThroughput = device.readThroughput > 0 && !device.readAssumed
+                ? device.readThroughput
+                : scratchWriteThroughput;
+            device.writeAssumed = device.writeThroughput > 0;
+        }
+    }
+}
+
+QStringList DryRunPlan::uncalibratedDevices() const
+{
+    QStringList uncalibrated;
+    for(auto i = devices.constBegin(); i != devices.constEnd(); ++i) {
+        if((i.value().bytesRead > 0 && i.value().readThroughput == 0)
+            || (i.value().bytesWritten > 0 && i.value().writeThroughput == 0)) {
+            uncalibrated << i.key();
+        }
+    }
+    if(renameLatency == 0) {
+        for(const Step & step : steps) {
+            if(step.kind != Copy && step.kind != Transform) {
+                uncalibrated << "renames and removals";
+                break;
+            }
+        }
+    }
+    if(transformThroughput == 0) {
+        for(const Step & step : steps) {
+            if(step.kind == Transform) {
+                uncalibrated << "transformations";
+                break;
+            }
+        }
+    }
+    return uncalibrated;
+}
+
+double DryRunPlan::estimateSeconds() const
+{
+    double total = overheadFiles * perFileOverhead;
+    for(const Step & step : steps) {
+        const DeviceStats & source = devices[step.sourceDevice];
+        const DeviceStats & target = devices[step.targetDevice];
+        switch(step.kind) {
+        case Transform:
+            total += perSecond(step.bytes, transformThroughput);
+            // fall through
+        case Copy:
+        case CrossDeviceMove:
+            total += perSecond(step.bytes, source.readThroughput) + perSecond(step.bytes, target.writeThroughput);
+            if(step.kind == CrossDeviceMove) total += renameLatency; // removing the source
+            break;
+        case Rename:
+        case Link:
+        case Remove:
+            total += renameLatency;
+            break;
+        }
+    }
+    return total;
+}
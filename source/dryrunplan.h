@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * @brief DryRunPlan - collects the operations a dry run skips, sums their bytes per device
+ * and estimates the real run's duration from a short calibration on a sample of the actual files.
+ * Calibration only reads the files, write speed and rename latency are measured in the temp location only.
+ * Devices without a measurement assume their read speed or the temp location's write speed,
+ * otherwise the estimate is reported as a lower bound. Recording is thread-safe.
+ */
+class DryRunPlan {
+    public:
+        enum Kind { Rename, Copy, CrossDeviceMove, Transform, Link, Remove };
+        enum Operation { CopyOperation, MoveOperation, TransformOperation, LinkOperation, RemoveOperation };
+
+        Kind record(Operation operation, const QString & sourceFilepath, const QString & targetFilepath = QString());
+        bool isEmpty() const;
+
+        void setPerFileOverhead(double seconds);
+        void addOverheadFiles(int count); // files passing through a batch which adds perFileOverhead each
+        void calibrate(int sampleCount = 4, qint64 sampleBytes = 16 << 20);
+        QStringList report() const;
+
+        static QString kindName(Kind kind);
+        static QString formatBytes(qint64 bytes);
+        static QString formatDuration(double seconds);
+
+    private:
+        struct Step {
+            Kind kind;
+            QString source, target;
+            QString sourceDevice, targetDevice;
+            qint64 bytes;
+        };
+        struct DeviceStats {
+            qint64 bytesRead = 0, bytesWritten = 0;
+            double readThroughput = 0, writeThroughput = 0; // bytes per second, 0 if not calibrated
+            bool readAssumed = false, writeAssumed = false; // taken from another measurement
+        };
+
+        QString deviceOf(const QString & path);
+        static QString existingDirectory(const QString & path);
+        void assumeUncalibrated(double scratchWriteThroughput);
+        QStringList uncalibratedDevices() const;
+        double estimateSeconds() const;
+
+        mutable QMutex mutex;
+        QVector<Step> steps;
+        QMap<QString, QString> deviceCache; // directory -> device
+        QMap<QString, DeviceStats> devices;
+        double perFileOverhead = 0;
+        int overheadFiles = 0;
+        double renameLatency = 0; // seconds, 0 if not calibrated
+        double transformThroughput = 0; // source bytes per second
+        int sampledFiles = 0;
+        qint64 sampledBytes = 0;
+};
@@ -0,0 +1,108 @@
+#include "filenamematcher.h"
+
+static const QRegularExpression::PatternOptions patternOptions = QRegularExpression::DontCaptureOption;
+
+void FileNameMatcher::addInclude(const QString & pattern, Syntax syntax)
+{
+    includes << toRegex(pattern, syntax);
+}
+
+void FileNameMatcher::addExclude(const QString & pattern, Syntax syntax)
+{
+    excludes << toRegex(pattern, syntax);
+}
+
+bool FileNameMatcher::compile()
+{
+    // validate one by one first with the options of the alternation,
+    // which itself would only report an offset
+    for(const QString & pattern : includes + excludes) {
+        const QRegularExpression regex(pattern, patternOptions);
+        if(!regex.isValid()) {
+            error = QString("%1 in \"%2\"").arg(regex.errorString()).arg(pattern);
+            return false;
+        }
+    }
+    includeRegex = alternation(includes);
+    excludeRegex = alternation(excludes);
+    for(const QRegularExpression * regex : {&includeRegex, &excludeRegex}) {
+        if(!regex->isValid()) {
+            error = QString("%1 in combined patterns").arg(regex->errorString());
+            return false;
+        }
+    }
+    error.clear();
+    return true;
+}
+
+const QString & FileNameMatcher::errorString() const
+{
+    return error;
+}
+
+bool FileNameMatcher::matches(const QString & filepath) const
+{
+    const int slash = qMax(filepath.lastIndexOf('/'), filepath.lastIndexOf('\\'));
+    const QStringRef name = filepath.midRef(slash + 1);
+    if(!includes.isEmpty() && !includeRegex.match(name).hasMatch()) {
+        return false;
+    }
+    return excludes.isEmpty() || !excludeRegex.match(name).hasMatch();
+}
+
+int FileNameMatcher::patternCount() const
+{
+    return includes.count() + excludes.count();
+}
+
+QString FileNameMatcher::wildcardToRegex(const QString & pattern)
+{
+    // QRegularExpression::wildcardToRegularExpression requires Qt 5.12
+    QString regex("^");
+    bool inBrackets = false;
+    for(int i = 0; i < pattern.length(); ++i) {
+        const QChar c = pattern[i];
+        if(inBrackets) {
+            if(c == ']') inBrackets = false;
+            regex.append(c == '\\' ? QString("\\\\") : QString(c));
+            continue;
+        }
+        switch(c.unicode()) {
+        case '*':
+            regex.append(".*");
+            break;
+        case '?':
+            regex.append('.');
+            break;
+        case '[':
+            inBrackets = true;
+            regex.append(c);
+            // shell negation [!...] is [^...] in regex syntax
+            if(i + 1 < pattern.length() && pattern[i + 1] == '!') {
+                regex.append('^');
+                ++i;
+            }
+            break;
+        default:
+            regex.append(QRegularExpression::escape(QString(c)));
+        }
+    }
+    return regex.append('$');
+}
+
+QString FileNameMatcher::toRegex(const QString & pattern, Syntax syntax)
+{
+    return syntax == Wildcard ? wildcardToRegex(pattern) : pattern;
+}
+
+QRegularExpression FileNameMatcher::alternation(const QStringList & patterns)
+{
+    QStringList groups;
+    for(const QString & pattern : patterns) {
+        groups << QString("(?:%1)").arg(pattern);
+    }
+    QRegularExpression regex(groups.join('|'), patternOptions);
+    // jit compile now instead of after the first matches
+    regex.optimize();
+    return regex;
+}
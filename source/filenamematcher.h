@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QRegularExpression>
+#include <QStringList>
+
+/**
+ * @brief FileNameMatcher - compiles any number of include/exclude patterns into one
+ * regex alternation per side, so matching a file costs a single (JIT) regex run
+ * regardless of the pattern count. Only the basename of a path is matched.
+ */
+class FileNameMatcher {
+    public:
+        enum Syntax { RegEx, Wildcard };
+
+        void addInclude(const QString & pattern, Syntax syntax = RegEx);
+        void addExclude(const QString & pattern, Syntax syntax = RegEx);
+        bool compile(); // returns false on the first invalid pattern, see errorString()
+        const QString & errorString() const;
+
+        bool matches(const QString & filepath) const;
+        int patternCount() const;
+
+        static QString wildcardToRegex(const QString & pattern);
+
+    private:
+        static QString toRegex(const QString & pattern, Syntax syntax);
+        static QRegularExpression alternation(const QStringList & patterns);
+
+        QStringList includes, excludes;
+        QRegularExpression includeRegex, excludeRegex;
+        QString error;
+};
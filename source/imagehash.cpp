@@ -0,0 +1,184 @@
+#include "imagehash.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QStringList>
+#include <QTextStream>
+
+static const int decodeSize = 64; // reduced decode, jpeg scales this down inside the decoder
+static const QString cacheHeader("# pscom-cli image hash cache v2"); // v2: hashes of the exif oriented image
+
+bool ImageHash::dHash(const QString & filepath, quint64 & hash)
+{
+    QImageReader reader(filepath);
+    // resized copies usually have the exif orientation baked into their pixels
+    reader.setAutoTransform(true);
+    const QSize size = reader.size();
+    if(size.isValid() && (size.width() > decodeSize || size.height() > decodeSize)) {
+        reader.setScaledSize(size.scaled(decodeSize, decodeSize, Qt::KeepAspectRatio));
+    }
+    const QImage image = reader.read();
+    if(image.isNull()) {
+        return false;
+    }
+    // 9x8 so every row yields 8 left-right gradient bits
+    const QImage gray = image
+        .scaled(9, 8, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+        .convertToFormat(QImage::Format_Grayscale8);
+    hash = 0;
+    for(int y = 0; y < 8; ++y) {
+        const uchar * row = gray.constScanLine(y);
+        for(int x = 0; x < 8; ++x) {
+            hash = (hash << 1) | (row[x] < row[x + 1] ? 1 : 0);
+        }
+    }
+    return true;
+}
+
+void BKTree::insert(quint64 hash, int id)
+{
+    nodes.append(Node { hash, id, {} });
+    const int inserted = nodes.count() - 1;
+    if(inserted == 0) {
+        return;
+    }
+    int current = 0;
+    while(true) {
+        const int distance = ImageHash::distance(hash, nodes[current].hash);
+        int next = -1;
+        for(const auto & child : nodes[current].children) {
+            if(child.first == distance) {
+                next = child.second;
+                break;
+            }
+        }
+        if(next < 0) {
+            nodes[current].children.append(qMakePair(distance, inserted));
+            return;
+        }
+        current = next;
+    }
+}
+
+QVector<int> BKTree::query(quint64 hash, int maxDistance) const
+{
+    QVector<int> found;
+    if(nodes.isEmpty()) {
+        return found;
+    }
+    QVector<int> pending { 0 };
+    while(!pending.isEmpty()) {
+        const Node & node = nodes[pending.takeLast()];
+        const int distance = ImageHash::distance(hash, node.hash);
+        if(distance <= maxDistance) {
+            found << node.id;
+        }
+        // triangle inequality: only subtrees within [d - r, d + r] can contain matches
+        for(const auto & child : node.children) {
+            if(child.first >= distance - maxDistance && child.first <= distance + maxDistance) {
+                pending << child.second;
+            }
+        }
+    }
+    return found;
+}
+
+int BKTree::count() const
+{
+    return nodes.count();
+}
+
+ImageHashCache::ImageHashCache(const QString & path)
+    : cachePath(path)
+{
+}
+
+bool ImageHashCache::load()
+{
+    entries.clear();
+    QFile file(cachePath);
+    if(!file.exists()) {
+        return true;
+    }
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return false;
+    }
+    QTextStream in(&file);
+    in.setCodec("UTF-8");
+    if(in.readLine() != cacheHeader) {
+        // another version, its hashes are recomputed
+        return true;
+    }
+    while(!in.atEnd()) {
+        const QString line = in.readLine();
+        if(line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+        const QStringList fields = line.split('\t');
+        if(fields.count() < 5) {
+            continue;
+        }
+        Entry entry;
+        entry.hash = fields[0].toULongLong(nullptr, 16);
+        entry.captured = fields[1].toLongLong();
+        entry.size = fields[2].toLongLong();
+        entry.modified = fields[3].toLongLong();
+        entries.insert(fields.mid(4).join('\t'), entry);
+    }
+    return true;
+}
+
+bool ImageHashCache::save() const
+{
+    QDir().mkpath(QFileInfo(cachePath).absolutePath());
+    QSaveFile file(cachePath);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return false;
+    }
+    QTextStream out(&file);
+    out.setCodec("UTF-8");
+    out << cacheHeader << '\n';
+    for(auto i = entries.constBegin(); i != entries.constEnd(); ++i) {
+        // deleted or moved files would otherwise stay forever
+        if(!QFileInfo::exists(i.key())) continue;
+        out << QString("%1").arg(i.value().hash, 16, 16, QChar('0'))
+            << '\t' << i.value().captured << '\t' << i.value().size << '\t' << i.value().modified
+            << '\t' << i.key() << '\n';
+    }
+    out.flush();
+    return file.commit();
+}
+
+const QString & ImageHashCache::path() const
+{
+    return cachePath;
+}
+
+bool ImageHashCache::lookup(const QString & filepath, Entry & entry) const
+{
+    const QFileInfo info(filepath);
+    const auto cached = entries.constFind(info.absoluteFilePath());
+    if(cached == entries.constEnd()
+        || cached->size != info.size()
+        || cached->modified != info.lastModified().toMSecsSinceEpoch()) {
+        return false;
+    }
+    entry = cached.value();
+    return true;
+}
+
+void ImageHashCache::insert(const QString & filepath, quint64 hash, qint64 captured)
+{
+    const QFileInfo info(filepath);
+    Entry entry;
+    entry.hash = hash;
+    entry.captured = captured;
+    entry.size = info.size();
+    entry.modified = info.lastModified().toMSecsSinceEpoch();
+    entries.insert(info.absoluteFilePath(), entry);
+}
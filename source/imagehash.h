@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QMap>
+#include <QPair>
+#include <QString>
+#include <QVector>
+#include <QtAlgorithms>
+
+/**
+ * @brief ImageHash - 64 bit difference hash (dHash) of an image decoded at reduced scale in its
+ * exif orientation, near-duplicates (resized, recompressed) differ in only a few bits
+ */
+class ImageHash {
+    public:
+        static bool dHash(const QString & filepath, quint64 & hash);
+
+        static inline int distance(quint64 a, quint64 b) {
+            return (int) qPopulationCount(a ^ b);
+        }
+};
+
+/**
+ * @brief BKTree - metric tree over hamming distances, finds every hash within a radius
+ * without comparing against all others
+ */
+class BKTree {
+    public:
+        void insert(quint64 hash, int id);
+        QVector<int> query(quint64 hash, int maxDistance) const;
+        int count() const;
+
+    private:
+        struct Node {
+            quint64 hash;
+            int id;
+            QVector<QPair<int, int>> children; // distance to the child, node index
+        };
+        QVector<Node> nodes;
+};
+
+/**
+ * @brief ImageHashCache - remembers hash and capture time per file, valid as long as size
+ * and modification time are unchanged. Stored as tab separated lines "hash captured size modified path",
+ * files that no longer exist are dropped on save.
+ */
+class ImageHashCache {
+    public:
+        struct Entry {
+            quint64 hash = 0;
+            qint64 captured = 0; // msecs since epoch
+            qint64 size = -1;
+            qint64 modified = 0; // msecs since epoch
+        };
+
+        explicit ImageHashCache(const QString & path);
+
+        bool load();
+        bool save() const;
+        const QString & path() const;
+
+        bool lookup(const QString & filepath, Entry & entry) const;
+        void insert(const QString & filepath, quint64 hash, qint64 captured);
+
+    private:
+        QString cachePath;
+        QMap<QString, Entry> entries; // absolute file path -> entry
+};
@@ -4,15 +4,43 @@
 #include <QCoreApplication>
 #include <QCommandLineOption>
 #include <QCommandLineParser>
+#include <QCryptographicHash>
 #include <QDebug>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
 #include <QFileInfo>
+#include <QImageReader>
 #include <QRegExp>
+#include <QSaveFile>
+#include <QStandardPaths>
 #include <QVersionNumber>
+#include <algorithm>
 #include <iostream>
 
 #include <QThread>
+#include <QtConcurrent>
 
+#ifdef Q_OS_UNIX
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+#include "archivewriter.h"
+#include "bytebudgetencoder.h"
+#include "chunkedcopy.h"
+#include "dryrunplan.h"
+#include "filenamematcher.h"
+#include "imagehash.h"
+#include "manifest.h"
 #include "verbosity.h"
 
 
@@ -119,7 +147,7 @@ QString progressMessage(int pos, int total, const QString & operation) {
 namespace IOSettings {
     QStringList sourceDirectories;
     QString targetDirectory = "./";
-    QRegExp filterRegex(".*");
+    FileNameMatcher fileNameMatcher;
     QString filterDateFormat = "yyyy-MM-dd";
     QDateTime filterDateTimeAfter, filterDateTimeBefore;
     bool recursive = false;
@@ -127,7 +155,11 @@ namespace IOSettings {
     bool forceOverwrite = false;
     bool createMissingFolders = false;
     bool dryRun = false;
+    DryRunPlan dryRunPlan;
     bool progressBar = false;
+    bool pacedOperations = true; // off for batches of near-instant operations like links
+    bool verifyCopies = false;
+    QString targetArchive;
 }
 
 namespace lib_utils {
@@ -200,7 +232,11 @@ namespace lib_utils {
                 _warn() << QString("Not a file to remove \"%1\"").arg(filepath);
                 return false;
             }
-            return IOSettings::dryRun || pscom::rm(filepath);
+            if(IOSettings::dryRun) {
+                IOSettings::dryRunPlan.record(DryRunPlan::RemoveOperation, filepath);
+                return true;
+            }
+            return pscom::rm(filepath);
         }
         bool isFileOverwritePermitted(
             const QString & targetFilepath, const QString & confirmationMessge,
@@ -221,6 +257,7 @@ namespace lib_utils {
         }
         bool safeFileOperation(
             const QString & actionName,
+            DryRunPlan::Operation plannedOperation,
             std::function<bool (const QString &, const QString &)> unsaveFileOp,
             const QString & sourceFilepath,
             const QString & targetFilepath,
@@ -242,16 +279,226 @@ namespace lib_utils {
                 }
             }
             _debug() << QString("%1 file \"%2\" to \"%3\"").arg(actionName).arg(sourceFilepath).arg(targetFilepath);
-            return IOSettings::dryRun || unsaveFileOp(sourceFilepath, targetFilepath);
+            if(IOSettings::dryRun) {
+                const auto kind = IOSettings::dryRunPlan.record(plannedOperation, sourceFilepath, targetFilepath);
+                _debug() << QString("Planned %1 \"%2\"").arg(DryRunPlan::kindName(kind)).arg(sourceFilepath);
+                return true;
+            }
+            return unsaveFileOp(sourceFilepath, targetFilepath);
+        }
+        namespace chunked_ops {
+            const qint64 chunkThreshold = 64 << 20;
+            const qint64 chunkSize = 16 << 20;
+
+            bool copy(const QString & sourceFilepath, const QString & targetFilepath) {
+                // large files would otherwise end up as a single-threaded tail of the batch
+                if(!ChunkedCopy::isSupported() || QFileInfo(sourceFilepath).size() < chunkThreshold) {
+                    return pscom::cp(sourceFilepath, targetFilepath);
+                }
+                _debug() << QString("Copying file in %1 MiB chunks \"%2\"").arg(chunkSize >> 20).arg(sourceFilepath);
+                ChunkedCopy chunkedCopy(chunkSize);
+                if(!chunkedCopy.copy(sourceFilepath, targetFilepath)) {
+                    _warn() << chunkedCopy.errorString();
+                    return false;
+                }
+                return true;
+            }
         }
         bool copyFile(const QString & sourceFilepath, const QString & targetFilepath, bool force = false, bool userConfirm = true) {
-            return safeFileOperation("Copying", pscom::cp, sourceFilepath, targetFilepath, force, userConfirm);
+            return safeFileOperation("Copying", DryRunPlan::CopyOperation, chunked_ops::copy, sourceFilepath, targetFilepath, force, userConfirm);
         }
         bool moveFile(const QString & sourceFilepath, const QString & targetFilepath, bool force = false, bool userConfirm = true) {
-            return safeFileOperation("Moving", pscom::mv, sourceFilepath, targetFilepath, force, userConfirm);
+            return safeFileOperation("Moving", DryRunPlan::MoveOperation, pscom::mv, sourceFilepath, targetFilepath, force, userConfirm);
         }
         bool renameFile(const QString & sourceFilepath, const QString & targetFilepath, bool force = false, bool userConfirm = true) {
-            return safeFileOperation("Renaming", pscom::mv, sourceFilepath, targetFilepath, force, userConfirm);
+            return safeFileOperation("Renaming", DryRunPlan::MoveOperation, pscom::mv, sourceFilepath, targetFilepath, force, userConfirm);
+        }
+
+        namespace verified_ops {
+            const int chunkSize = 1 << 20;
+
+            QByteArray hashFile(const QString & filepath) {
+                QFile file(filepath);
+                if(!file.open(QIODevice::ReadOnly)) {
+                    return QByteArray();
+                }
+                QCryptographicHash hash(QCryptographicHash::Sha256);
+                if(!hash.addData(&file)) {
+                    return QByteArray();
+                }
+                return hash.result().toHex();
+            }
+            void syncAndEvict(QFile & file) {
+                file.flush();
+#ifdef Q_OS_UNIX
+                // flush to the device and drop the cached pages, so reading the copy back
+                // hits the media (and the filesystem's own checksums) instead of the page cache
+                ::fsync(file.handle());
+#ifdef POSIX_FADV_DONTNEED
+                ::posix_fadvise(file.handle(), 0, 0, POSIX_FADV_DONTNEED);
+#endif
+#endif
+            }
+            bool replaceFile(const QString & filepath, const QString & targetFilepath) {
+                // replaces an existing target in one step, so it never goes missing in between
+#if defined(Q_OS_UNIX)
+                return ::rename(QFile::encodeName(filepath).constData(), QFile::encodeName(targetFilepath).constData()) == 0;
+#elif defined(Q_OS_WIN)
+                return MoveFileExW((LPCWSTR) QDir::toNativeSeparators(filepath).utf16(),
+                    (LPCWSTR) QDir::toNativeSeparators(targetFilepath).utf16(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+#else
+                QFile::remove(targetFilepath);
+                return QFile::rename(filepath, targetFilepath);
+#endif
+            }
+            /**
+             * @brief copies the source in one read pass while hashing it into a partial file,
+             * checks the hash of the written copy and only then renames it to the target
+             */
+            bool hashingCopy(const QString & sourceFilepath, const QString & targetFilepath, QByteArray & hashHex) {
+                QFile source(sourceFilepath), target(targetFilepath + ".pscom-part");
+                if(!source.open(QIODevice::ReadOnly)) {
+                    _warn() << QString("Reading file failed \"%1\"").arg(sourceFilepath);
+                    return false;
+                }
+                if(!target.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                    _warn() << QString("Writing file failed \"%1\"").arg(targetFilepath);
+                    return false;
+                }
+                QCryptographicHash hash(QCryptographicHash::Sha256);
+                QByteArray buffer(chunkSize, Qt::Uninitialized);
+                qint64 read;
+                while((read = source.read(buffer.data(), buffer.size())) > 0) {
+                    hash.addData(buffer.constData(), (int) read);
+                    if(target.write(buffer.constData(), read) != read) {
+                        read = -1;
+                        break;
+                    }
+                }
+                if(read < 0) {
+                    _warn() << QString("Copying file failed \"%1\"").arg(sourceFilepath);
+                    target.remove();
+                    return false;
+                }
+                syncAndEvict(target);
+                target.close();
+                target.setPermissions(source.permissions());
+                hashHex = hash.result().toHex();
+                if(hashFile(target.fileName()) != hashHex) {
+                    _warn() << QString("Verification failed, removing corrupt copy \"%1\"").arg(targetFilepath);
+                    target.remove();
+                    return false;
+                }
+                if(!replaceFile(target.fileName(), targetFilepath)) {
+                    _warn() << QString("Writing file failed \"%1\"").arg(targetFilepath);
+                    target.remove();
+                    return false;
+                }
+                return true;
+            }
+        }
+        namespace link_ops {
+            enum class LinkType { None, Hard, Symbolic, Reflink };
+
+            LinkType linkTypeFromName(const QString & name) {
+                static const QMap<QString, LinkType> types({
+                    std::make_pair("hard", LinkType::Hard),
+                    std::make_pair("sym", LinkType::Symbolic),
+                    std::make_pair("symbolic", LinkType::Symbolic),
+                    std::make_pair("reflink", LinkType::Reflink)
+                });
+                return types.value(name.toLower(), LinkType::None);
+            }
+            bool hardLink(const QString & sourceFilepath, const QString & targetFilepath) {
+#if defined(Q_OS_UNIX)
+                return ::link(QFile::encodeName(sourceFilepath).constData(), QFile::encodeName(targetFilepath).constData()) == 0;
+#elif defined(Q_OS_WIN)
+                return CreateHardLinkW((LPCWSTR) targetFilepath.utf16(), (LPCWSTR) sourceFilepath.utf16(), NULL) != FALSE;
+#else
+                return false;
+#endif
+            }
+            bool symbolicLink(const QString & sourceFilepath, const QString & targetFilepath) {
+                // absolute, so the view does not depend on the location of the group directory
+                const QString absoluteSource = QFileInfo(sourceFilepath).absoluteFilePath();
+#if defined(Q_OS_UNIX)
+                return QFile::link(absoluteSource, targetFilepath);
+#elif defined(Q_OS_WIN)
+                // QFile::link would create a .lnk shortcut, not a symbolic link
+#ifndef SYMBOLIC_LINK_FLAG_ALLOW_UNPRIVILEGED_CREATE
+#define SYMBOLIC_LINK_FLAG_ALLOW_UNPRIVILEGED_CREATE 0x2
+#endif
+                const QString nativeSource = QDir::toNativeSeparators(absoluteSource);
+                const QString nativeTarget = QDir::toNativeSeparators(targetFilepath);
+                return CreateSymbolicLinkW((LPCWSTR) nativeTarget.utf16(), (LPCWSTR) nativeSource.utf16(),
+                    SYMBOLIC_LINK_FLAG_ALLOW_UNPRIVILEGED_CREATE) != FALSE;
+#else
+                Q_UNUSED(targetFilepath);
+                _warn() << "Symbolic links are not supported on this platform";
+                return false;
+#endif
+            }
+            bool reflink(const QString & sourceFilepath, const QString & targetFilepath) {
+#if defined(Q_OS_LINUX) && defined(FICLONE)
+                // copy-on-write clone sharing the data extents (btrfs, xfs)
+                QFile source(sourceFilepath), target(targetFilepath);
+                if(!source.open(QIODevice::ReadOnly) || !target.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                    return false;
+                }
+                if(::ioctl(target.handle(), FICLONE, source.handle()) != 0) {
+                    target.remove();
+                    return false;
+                }
+                return true;
+#else
+                Q_UNUSED(sourceFilepath);
+                Q_UNUSED(targetFilepath);
+                _warn() << "Reflinks are not supported on this platform";
+                return false;
+#endif
+            }
+        }
+        bool linkFile(
+            const QString & sourceFilepath, const QString & targetFilepath, link_ops::LinkType type,
+            bool force = false, bool userConfirm = true
+        ) {
+            using namespace link_ops;
+            std::function<bool (const QString &, const QString &)> linkOp;
+            switch(type) {
+            case LinkType::Hard:
+                linkOp = hardLink;
+                break;
+            case LinkType::Symbolic:
+                linkOp = symbolicLink;
+                break;
+            case LinkType::Reflink:
+                linkOp = reflink;
+                break;
+            case LinkType::None:
+                return moveFile(sourceFilepath, targetFilepath, force, userConfirm);
+            }
+            return safeFileOperation("Linking", DryRunPlan::LinkOperation, linkOp, sourceFilepath, targetFilepath, force, userConfirm);
+        }
+        bool verifiedCopyFile(
+            const QString & sourceFilepath, const QString & targetFilepath, Manifest & manifest,
+            bool force = false, bool userConfirm = true
+        ) {
+            if(manifest.isUnchanged(sourceFilepath, targetFilepath)) {
+                _debug() << QString("Skipped unchanged file \"%1\"").arg(sourceFilepath);
+                return true;
+            }
+            return safeFileOperation("Copying", DryRunPlan::CopyOperation, [&](const QString & source, const QString & target) {
+                QByteArray hash;
+                if(!verified_ops::hashingCopy(source, target, hash)) {
+                    return false;
+                }
+                _debug() << QString("Verified copy \"%1\" sha256=%2").arg(target).arg(QString(hash));
+                // recorded right away, an interrupted run still skips what it verified
+                if(!manifest.append(target, Manifest::entryFor(source, hash))) {
+                    _warn() << QString("Manifest could not be written \"%1\"").arg(manifest.path());
+                }
+                return true;
+            }, sourceFilepath, targetFilepath, force, userConfirm);
         }
 
         bool createDirectories(const QString & path) {
@@ -285,26 +532,43 @@ namespace lib_utils {
                 return fileCreationDateTime(filename) < maxDateTime;
             });
         }
-        QStringList listFiles(const QString & path, bool recursive, const QRegExp & regex = QRegExp(".*")) {
+        void filterFileListNames(QStringList & fileList, const FileNameMatcher & matcher) {
+            if(matcher.patternCount() == 0) {
+                return;
+            }
+            QElapsedTimer timer;
+            timer.start();
+            const int total = fileList.count();
+            filter(fileList, [&](const QString & filename) {
+                return matcher.matches(filename);
+            });
+            if(total > 0) {
+                _debug() << QString("Matched %1 path(s) against %2 pattern(s) in %3 ns/path")
+                    .arg(total).arg(matcher.patternCount()).arg(timer.nsecsElapsed() / total);
+            }
+        }
+        QStringList listFiles(const QString & path, bool recursive, const FileNameMatcher & matcher = FileNameMatcher()) {
             if(!isPathExistingDirectory(path)) {
                 abnormalExit(QString("Source directory not found \"%1\"").arg(path), 6);
             }
             _debug() << QString("Listing directory \"%1\"").arg(path);
-            auto fileList = pscom::re(path, regex, recursive);
+            // patterns are matched against basenames below instead of full paths inside the library
+            auto fileList = pscom::re(path, QRegExp(".*"), recursive);
+            filterFileListNames(fileList, matcher);
             filterFileListExtensions(fileList, supportedFormats());
             _debug() << QString("%1 supported files found").arg(fileList.count());
             return fileList;
         }
-        QStringList listFiles(const QStringList & paths, bool recursive, const QRegExp & regex = QRegExp(".*")) {
+        QStringList listFiles(const QStringList & paths, bool recursive, const FileNameMatcher & matcher = FileNameMatcher()) {
             QStringList files;
             for(const QString & path : paths) {
-                files.append(listFiles(path, recursive, regex));
+                files.append(listFiles(path, recursive, matcher));
             }
             return files;
         }
         QStringList listFiles() {
             using namespace IOSettings;
-            auto fileList = listFiles(sourceDirectories, recursive, filterRegex);
+            auto fileList = listFiles(sourceDirectories, recursive, fileNameMatcher);
             if(filterDateTimeAfter.isValid()) {
                 filterFileListDateAfter(fileList, filterDateTimeAfter);
             }
@@ -315,6 +579,7 @@ namespace lib_utils {
             return fileList;
         }
 
+        const unsigned long operationDelay = 200; // ms per file, keeps the progress bar readable
         QStringList multiFileOperation(
             const QStringList & fileList,
             std::function<QString (const QString &)> operationMessage,
@@ -323,13 +588,14 @@ namespace lib_utils {
         ) {
             QStringList unsuccessful;
             const int total = fileList.count();
+            const bool paced = IOSettings::progressBar && IOSettings::pacedOperations;
             for(int i = 0; i < total; ++i) {
                 const QString filepath = fileList[i];
                 const int pos = i + 1;
                 if(!silent)
                     _info() << progressMessage(pos, total, operationMessage(filepath));
                 if(IOSettings::progressBar) drawProgressBar((pos-1)*1.0/total);
-                QThread::msleep(200);
+                if(paced) QThread::msleep(operationDelay);
                 bool success = operation(filepath);
                 _debug() << progressMessage(pos, total, QString("Finished %1").arg(operationMessage(filepath)));
                 if(IOSettings::progressBar) drawProgressBar(pos*1.0/total);
@@ -338,6 +604,9 @@ namespace lib_utils {
                 }
             }
             clearProgressBar();
+            if(IOSettings::dryRun && paced) {
+                IOSettings::dryRunPlan.addOverheadFiles(total);
+            }
             return unsuccessful;
         }
     }
@@ -352,7 +621,11 @@ namespace lib_utils {
                 _warn() << QString("Format not supported \"%1\"").arg(filepath);
                 return false;
             }
-            return IOSettings::dryRun || op(filepath);
+            if(IOSettings::dryRun) {
+                IOSettings::dryRunPlan.record(DryRunPlan::TransformOperation, filepath);
+                return true;
+            }
+            return op(filepath);
         }
         bool scaleToWidth(const QString & filepath, int width) {
             _debug() << QString("Scaling image to width %1 \"%2\"").arg(width).arg(filepath);
@@ -378,6 +651,53 @@ namespace lib_utils {
                 return pscom::cf(filepath, format, quality);
             });
         }
+
+        struct BudgetResult {
+            bool success;
+            QString message;
+            bool removeOriginal; // converted in place into another format, left to the caller
+        };
+        /**
+         * @brief decodes the source once and writes only the encoding that fits the budget,
+         * thread-safe as long as every call gets its own target
+         */
+        BudgetResult fitToByteBudget(
+            const QString & sourceFilepath, const QString & targetFilepath, const QString & format,
+            qint64 maxBytes, int maxQuality, int width = 0, int height = 0
+        ) {
+            QImageReader reader(sourceFilepath);
+            reader.setAutoTransform(true);
+            QImage image = reader.read();
+            if(image.isNull()) {
+                return { false, QString("Reading image failed \"%1\": %2").arg(sourceFilepath).arg(reader.errorString()), false };
+            }
+            if(width > 0 && height > 0) {
+                image = image.scaled(width, height, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+            } else if(width > 0) {
+                image = image.scaledToWidth(width, Qt::SmoothTransformation);
+            } else if(height > 0) {
+                image = image.scaledToHeight(height, Qt::SmoothTransformation);
+            }
+            ByteBudgetEncoder encoder(maxBytes, format.toLatin1(), maxQuality);
+            ByteBudgetEncoder::Result result;
+            if(!encoder.encode(image, result)) {
+                return { false, QString("Fitting image into %L1 bytes failed \"%2\": %3")
+                    .arg(maxBytes).arg(sourceFilepath).arg(encoder.errorString()), false };
+            }
+            const QString details = QString("%L1 bytes at quality %2 and %3x%4 after %5 attempt(s) \"%6\"")
+                .arg(result.data.size()).arg(result.quality)
+                .arg(result.size.width()).arg(result.size.height())
+                .arg(result.attempts).arg(targetFilepath);
+            if(IOSettings::dryRun) {
+                IOSettings::dryRunPlan.record(DryRunPlan::TransformOperation, sourceFilepath, targetFilepath);
+                return { true, details, false };
+            }
+            QSaveFile target(targetFilepath);
+            if(!target.open(QIODevice::WriteOnly) || target.write(result.data) != result.data.size() || !target.commit()) {
+                return { false, QString("Writing image failed \"%1\"").arg(targetFilepath), false };
+            }
+            return { true, details, false };
+        }
     }
 }
 
@@ -415,7 +735,9 @@ static const QCommandLineOption supportedFormatsFlag("supported-formats", "Lists
 // general task flags
 static const QCommandLineOption searchRecursivelyFlag({"r", "recursive"}, "Traverse the directory recursively.");
 static const QCommandLineOption sourceDirectoryOption({"s", "source", "dir"}, "Source directory.", "source directory", "./");
-static const QCommandLineOption filterRegexOption({"match", "regex"}, "Match the filenames against the given regex.", "regex");
+static const QCommandLineOption filterRegexOption({"match", "regex"}, "Match the filenames against the given regex. Can be repeated, a file matching any of them is kept.", "regex");
+static const QCommandLineOption filterExcludeOption("exclude", "Drop files whose names match the given regex. Can be repeated.", "regex");
+static const QCommandLineOption filterGlobFlag("glob", "Interpret --match and --exclude patterns as wildcards, e.g. \"IMG_*.jpg\".");
 static const QCommandLineOption filterDateFormatOption("datetime-format", "Used format for filtering with --after or --before. Default: yyyy-MM-dd (ISO 8601)", "datetime-format", "yyyy-MM-dd");
 static const QCommandLineOption filterDateTimeAfterOption("after", "Filter the images to be created after the given date (exclusive).", "datetime");
 static const QCommandLineOption filterDateTimeBeforeOption("before", "Filter the images to be created before the given date (exclusive).", "datetime");
@@ -427,33 +749,43 @@ static const QCommandLineOption fileOPsSkipExistingFlag({"skip", "skip-existing"
 static const QCommandLineOption fileOPsForceOverwriteFlag({"force", "overwrite"}, "Overwrite existing images without asking.");
 static const QCommandLineOption fileOPsCreateDirectoriesFlag({"mkdirs", "create-directories"}, "Creates missing directories.");
 static const QCommandLineOption fileOPsDryRunFlag({"dry-run", "noop"}, "Simulate every file operation without actually doing it.");
+static const QCommandLineOption targetArchiveOption("target-archive", "Write the files into one tar or zip (store) archive instead, member names follow the target paths. \"-\" streams a tar to stdout.", "archive");
+static const QCommandLineOption copyVerifyFlag("verify", "Hash files while copying, verify the written copies and keep a manifest in the target directory to skip unchanged files next time.");
 
 // task flags
 static const QCommandLineOption renameSchemeOption("scheme", "Date time format for renaming the images. Default is UPA scheme: yyyyMMdd_HHmmsszzz", "datetime-format", "yyyyMMdd_HHmmsszzz");
 static const QCommandLineOption groupSchemeOption("scheme", "Date format for renaming the folders. Default is UPA scheme with %1 being a possible \" location - event\" definition: yyyy/yyyy-MM%1", "date-format", "yyyy/yyyy-MM%1");
 static const QCommandLineOption groupLocationOption({"location", "city"}, "Location name for folder grouping.", "location");
 static const QCommandLineOption groupEventOption({"event", "activity"}, "Event name for folder grouping.", "event");
+static const QCommandLineOption groupLinkOption("link", "Build the group directories out of links and keep the originals in place: hard, sym or reflink.", "link-type");
+static const QCommandLineOption dupesDistanceOption("distance", "Maximum number of differing bits between the 64 bit image hashes of duplicates. Default: 6", "bits", "6");
+static const QCommandLineOption dupesActionOption("action", "What to do with the duplicates, every image within --distance of the largest one is a duplicate of it: list, move (into --target) or remove. Default: list", "action", "list");
 static const QCommandLineOption transformCopySuffixOption("suffix", "Keeps the original image and works on a renamed copy with suffixed file base name. Default: _new", "suffix", "_new");
 static const QCommandLineOption transformShrinkWidthOption("width", "New image width in px.", "width");
 static const QCommandLineOption transformShrinkHeightOption("height", "New image height in px.", "height");
 static const QCommandLineOption transformFormatOption("format", "New image format (check supported formats with --supported-formats).", "format");
 static const QCommandLineOption transformQualityOption("quality", "New image quality between 0 and 100. Default: 70", "quality", "70");
+static const QCommandLineOption transformMaxBytesOption("max-bytes", "Fit each image into the given size, e.g. 500k or 2M, searching the best quality up to --quality (95 unless given) and downscaling if needed. Images already within the size keep their bytes unless --width, --height or --format is given.", "bytes");
 
 void registerFileListingSettings(QCommandLineParser & parser) {
     parser.addOptions({sourceDirectoryOption, searchRecursivelyFlag});
-    parser.addOptions({filterRegexOption, filterDateFormatOption, filterDateTimeAfterOption, filterDateTimeBeforeOption});
+    parser.addOptions({filterRegexOption, filterExcludeOption, filterGlobFlag, filterDateFormatOption, filterDateTimeAfterOption, filterDateTimeBeforeOption});
 }
 void parseFileListingSettings(const QCommandLineParser & parser) {
     using namespace IOSettings;
     recursive = parser.isSet(searchRecursivelyFlag);
     sourceDirectories = parser.values(sourceDirectoryOption);
-    if(parser.isSet(filterRegexOption)) {
-        QString regexString = parser.value(filterRegexOption);
-        filterRegex = QRegExp(regexString);
-        if(!filterRegex.isValid()) {
-            abnormalExit(QString("Invalid regex given \"%1\"").arg(regexString), 3);
-        }
-        _debug() << QString("Filtering directories using regex=\"%1\"").arg(regexString);
+    const auto syntax = parser.isSet(filterGlobFlag) ? FileNameMatcher::Wildcard : FileNameMatcher::RegEx;
+    for(const QString & pattern : parser.values(filterRegexOption)) {
+        fileNameMatcher.addInclude(pattern, syntax);
+        _debug() << QString("Filtering directories using match=\"%1\"").arg(pattern);
+    }
+    for(const QString & pattern : parser.values(filterExcludeOption)) {
+        fileNameMatcher.addExclude(pattern, syntax);
+        _debug() << QString("Filtering directories using exclude=\"%1\"").arg(pattern);
+    }
+    if(!fileNameMatcher.compile()) {
+        abnormalExit(QString("Invalid pattern given: %1").arg(fileNameMatcher.errorString()), 3);
     }
     if(parser.isSet(filterDateFormatOption)) {
         filterDateFormat = parser.value(filterDateFormatOption);
@@ -555,6 +887,103 @@ void fileBatcherWithRetry(
         .arg(total - finalProblems.count()).arg(finalProblems.count());
 }
 
+namespace archive_ops {
+    const qint64 prefetchLimit = 16 << 20;
+
+    QByteArray prefetch(const QString & filepath) {
+        // larger files are streamed by the writer itself
+        QFile file(filepath);
+        if(file.size() > prefetchLimit || !file.open(QIODevice::ReadOnly)) {
+            return QByteArray();
+        }
+        return file.readAll();
+    }
+}
+
+void parseTargetArchiveSettings(const QCommandLineParser & parser) {
+    using namespace IOSettings;
+    if(!parser.isSet(targetArchiveOption)) {
+        return;
+    }
+    targetArchive = parser.value(targetArchiveOption);
+    ArchiveWriter::Format format;
+    if(!ArchiveWriter::formatFromPath(targetArchive, format)) {
+        abnormalExit(QString("Unsupported archive \"%1\" - use .tar, .zip or - for stdout").arg(targetArchive), 3);
+    }
+    if(targetArchive == "-") {
+        // the output was already moved to stderr in initParserAndLogging
+        progressBar = false;
+    }
+    _debug() << QString("Writing into archive \"%1\"").arg(targetArchive);
+}
+
+/**
+ * @brief reads the files in parallel ahead of the writer and appends them in list order to IOSettings::targetArchive
+ */
+void archiveBatcher(
+    const QString & opName,
+    std::function<const QString(const QString &)> targetPathSupplier
+) {
+    using namespace lib_utils::io_ops;
+    using namespace IOSettings;
+    ArchiveWriter::Format format;
+    ArchiveWriter::formatFromPath(targetArchive, format);
+    auto fileList = listFiles();
+    const int total = fileList.count();
+
+    QFile archive;
+    if(!dryRun) {
+        bool opened;
+        if(targetArchive == "-") {
+            opened = archive.open(stdout, QIODevice::WriteOnly);
+        } else {
+            archive.setFileName(targetArchive);
+            opened = archive.open(QIODevice::WriteOnly | QIODevice::Truncate);
+        }
+        if(!opened) {
+            abnormalExit(QString("Archive could not be created \"%1\"").arg(targetArchive), 5);
+        }
+    }
+    ArchiveWriter writer(&archive, format);
+
+    const int window = qMax(2, QThread::idealThreadCount() * 2);
+    QList<QFuture<QByteArray>> prefetched;
+    int next = 0;
+    QStringList unsuccessful;
+    for(int i = 0; i < total; ++i) {
+        while(!dryRun && next < total && prefetched.count() < window) {
+            prefetched << QtConcurrent::run(archive_ops::prefetch, fileList[next++]);
+        }
+        const QString filepath = fileList[i];
+        const QString memberName = QDir(targetDirectory).relativeFilePath(targetPathSupplier(filepath));
+        const int pos = i + 1;
+        _info() << progressMessage(pos, total, QString("%1 %2 as \"%3\"").arg(opName).arg(filepath).arg(memberName));
+        if(progressBar) drawProgressBar((pos-1)*1.0/total);
+        if(dryRun) {
+            dryRunPlan.record(DryRunPlan::CopyOperation, filepath, targetArchive);
+            continue;
+        }
+        const QByteArray data = prefetched.takeFirst().result();
+        const qint64 written = writer.bytesWritten();
+        if(!(data.isNull() ? writer.addFile(memberName, filepath) : writer.addFile(memberName, filepath, &data))) {
+            if(writer.bytesWritten() != written) {
+                // a partially written member cannot be taken back from a stream
+                fatalExit(QString("Archive is incomplete: %1").arg(writer.errorString()));
+            }
+            _warn() << writer.errorString();
+            unsuccessful << filepath;
+        }
+        if(progressBar) drawProgressBar(pos*1.0/total);
+    }
+    clearProgressBar();
+    if(!dryRun && (!writer.finish() || !archive.flush())) {
+        fatalExit(QString("Archive is incomplete: %1").arg(writer.errorString()));
+    }
+    archive.close();
+    _info() << QString("%1 completed (%2 file(s) archived / %3 failed, %L4 bytes)!").arg(opName)
+        .arg(total - unsuccessful.count()).arg(unsuccessful.count()).arg(writer.bytesWritten());
+}
+
 const QString clearDateFormattingTemplate(QString input) {
     return input.replace('\'', "''").replace('\\', '_').replace('/', '_');
 }
@@ -581,18 +1010,49 @@ static const QMap<QString, Task> tasks({
             parser.clearPositionalArguments();
             parser.addPositionalArgument("copy", "Copy all (filtered) images found in the source directories to the target directory.", "copy [file-options]");
             registerTargetIOSettings(parser);
+            parser.addOptions({copyVerifyFlag, targetArchiveOption});
         },
         [](QCommandLineParser & parser) {
             parseTargetIOSettings(parser);
+            parseTargetArchiveSettings(parser);
             using namespace lib_utils::io_ops;
             using namespace IOSettings;
+            verifyCopies = parser.isSet(copyVerifyFlag);
+            if(!targetArchive.isEmpty()) {
+                if(verifyCopies) {
+                    abnormalExit("Invalid arguments: --verify cannot be combined with --target-archive");
+                }
+                archiveBatcher("Archiving", [&](const QString & filepath) {
+                    return targetDirectory + filepath_ops::fileName(filepath);
+                });
+                return 0;
+            }
+            Manifest manifest(targetDirectory);
+            if(verifyCopies) {
+                if(!manifest.load()) {
+                    abnormalExit(QString("Manifest could not be read \"%1\"").arg(manifest.path()), 7);
+                }
+                _debug() << QString("Loaded %1 manifest entries from \"%2\"").arg(manifest.count()).arg(manifest.path());
+            }
             _info() << QString("Copying files to \"%1\"").arg(targetDirectory);
             fileBatcherWithRetry("Copying",
                 [&](const QString & filepath) {
                     return targetDirectory + filepath_ops::fileName(filepath);
                 },
-                copyFile
+                [&](const QString & sourceFilepath, const QString & targetFilepath, bool force, bool userConfirm) {
+                    if(verifyCopies) {
+                        return verifiedCopyFile(sourceFilepath, targetFilepath, manifest, force, userConfirm);
+                    }
+                    return copyFile(sourceFilepath, targetFilepath, force, userConfirm);
+                }
             );
+            if(verifyCopies && !dryRun) {
+                // rewrite without the lines superseded by appends
+                if(!manifest.save()) {
+                    abnormalExit(QString("Manifest could not be written \"%1\"").arg(manifest.path()), 7);
+                }
+                _info() << QString("Manifest written \"%1\"").arg(manifest.path());
+            }
             return 0;
         }
     }),
@@ -641,10 +1101,11 @@ static const QMap<QString, Task> tasks({
             parser.clearPositionalArguments();
             parser.addPositionalArgument("group", "Group all (filtered) images found in the source directories into newly created folders following the upa scheme.", "group [group-options]");
             registerTargetIOSettings(parser);
-            parser.addOptions({groupSchemeOption, groupLocationOption, groupEventOption});
+            parser.addOptions({groupSchemeOption, groupLocationOption, groupEventOption, groupLinkOption, targetArchiveOption});
         },
         [](QCommandLineParser & parser) {
             parseTargetIOSettings(parser);
+            parseTargetArchiveSettings(parser);
             QStringList detailList;
             const QString schemeFormat = parser.value(groupSchemeOption);
             if(parser.isSet(groupLocationOption))
@@ -655,14 +1116,31 @@ static const QMap<QString, Task> tasks({
             const QString datetimeFormat = schemeFormat.arg(groupDescription);
             using namespace lib_utils::io_ops;
             using namespace IOSettings;
-            fileBatcherWithRetry("Grouping",
-                [&](const QString & filepath) {
-                    return filepath_ops::pathInsertDatedDirectory(
-                        targetDirectory, datetimeFormat,
-                        fileCreationDateTime(filepath).date()
-                    ) + filepath_ops::fileName(filepath);
-                },
-                [](const QString & sourceFilepath, const QString & targetFilepath, bool force, bool userConfirm) {
+            const auto groupTargetPath = [&](const QString & filepath) {
+                return filepath_ops::pathInsertDatedDirectory(
+                    targetDirectory, datetimeFormat,
+                    fileCreationDateTime(filepath).date()
+                ) + filepath_ops::fileName(filepath);
+            };
+            if(!targetArchive.isEmpty()) {
+                if(parser.isSet(groupLinkOption)) {
+                    abnormalExit("Invalid arguments: --link cannot be combined with --target-archive");
+                }
+                archiveBatcher("Archiving", groupTargetPath);
+                return 0;
+            }
+            auto linkType = link_ops::LinkType::None;
+            if(parser.isSet(groupLinkOption)) {
+                linkType = link_ops::linkTypeFromName(parser.value(groupLinkOption));
+                if(linkType == link_ops::LinkType::None) {
+                    abnormalExit(QString("Unknown link type \"%1\" - use hard, sym or reflink").arg(parser.value(groupLinkOption)), 3);
+                }
+                _debug() << QString("Linking files into group directories using %1 links").arg(parser.value(groupLinkOption));
+                pacedOperations = false;
+            }
+            fileBatcherWithRetry(linkType == link_ops::LinkType::None ? "Grouping" : "Linking",
+                groupTargetPath,
+                [&](const QString & sourceFilepath, const QString & targetFilepath, bool force, bool userConfirm) {
                     const auto path = filepath_ops::directoryPath(targetFilepath);
                     if(!isPathExistingDirectory(path)) {
                         if(!createDirectories(path)) {
@@ -670,12 +1148,164 @@ static const QMap<QString, Task> tasks({
                         }
                         _debug() << QString("Created group directory \"%1\"").arg(path);
                     }
-                    return moveFile(sourceFilepath, targetFilepath, force, userConfirm);
+                    return linkFile(sourceFilepath, targetFilepath, linkType, force, userConfirm);
                 }
             );
             return 0;
         }
     }),
+    std::make_pair("dupes", Task {
+        [](QCommandLineParser & parser) {
+            parser.clearPositionalArguments();
+            parser.addPositionalArgument("dupes", "Find near-duplicate images (resized or recompressed copies) among all (filtered) images found in the source directories.", "dupes [dupes-options]");
+            registerTargetIOSettings(parser);
+            parser.addOptions({dupesDistanceOption, dupesActionOption});
+        },
+        [](QCommandLineParser & parser) {
+            parseTargetIOSettings(parser);
+            using namespace lib_utils::io_ops;
+            using namespace IOSettings;
+            bool distanceOk;
+            const int maxDistance = parser.value(dupesDistanceOption).toInt(&distanceOk);
+            if(!distanceOk || maxDistance < 0 || maxDistance > 64) {
+                abnormalExit(QString("Invalid distance \"%1\"").arg(parser.value(dupesDistanceOption)), 3);
+            }
+            const QString action = parser.value(dupesActionOption).toLower();
+            if(!QStringList({"list", "move", "remove"}).contains(action)) {
+                abnormalExit(QString("Unknown action \"%1\" - use list, move or remove").arg(action), 3);
+            }
+            if(action == "move" && !parser.isSet(targetDirectoryOption)) {
+                abnormalExit("Invalid arguments: --action move requires --target");
+            }
+
+            const auto fileList = listFiles();
+            const int total = fileList.count();
+            ImageHashCache cache(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/dhash.tsv");
+            if(!cache.load()) {
+                _warn() << QString("Image hash cache could not be read \"%1\"").arg(cache.path());
+            }
+            QVector<ImageHashCache::Entry> entries(total);
+            QVector<bool> hashed(total, true);
+            QVector<int> missing;
+            for(int i = 0; i < total; ++i) {
+                if(!cache.lookup(fileList[i], entries[i])) {
+                    missing << i;
+                }
+            }
+            _debug() << QString("%1 of %2 image hash(es) cached in \"%3\"").arg(total - missing.count()).arg(total).arg(cache.path());
+
+            // hashing decodes at reduced scale, one image per worker
+            struct HashResult {
+                bool success;
+                quint64 hash;
+            };
+            const std::function<HashResult (int)> job = [&](int i) {
+                HashResult result { false, 0 };
+                result.success = ImageHash::dHash(fileList[i], result.hash);
+                return result;
+            };
+            auto results = QtConcurrent::mapped(missing, job);
+            for(int k = 0; k < missing.count(); ++k) {
+                const int i = missing[k];
+                if(progressBar) drawProgressBar(k*1.0/missing.count());
+                const auto result = results.resultAt(k);
+                if(!result.success) {
+                    _warn() << QString("Hashing image failed \"%1\"").arg(fileList[i]);
+                    hashed[i] = false;
+                    continue;
+                }
+                // the library is only called from the main thread
+                const QDateTime captured = fileCreationDateTime(fileList[i]);
+                cache.insert(fileList[i], result.hash, captured.isValid() ? captured.toMSecsSinceEpoch() : 0);
+                cache.lookup(fileList[i], entries[i]);
+            }
+            clearProgressBar();
+            if(!missing.isEmpty() && !cache.save()) {
+                _warn() << QString("Image hash cache could not be written \"%1\"").arg(cache.path());
+            }
+
+            // star clusters: the best remaining image keeps every unassigned one within the distance,
+            // so a duplicate is never further than the distance from its keeper
+            BKTree tree;
+            QVector<int> keeperOrder;
+            for(int i = 0; i < total; ++i) {
+                if(!hashed[i]) continue;
+                tree.insert(entries[i].hash, i);
+                keeperOrder << i;
+            }
+            // keep the largest (least recompressed) file, the earliest capture on ties
+            std::sort(keeperOrder.begin(), keeperOrder.end(), [&](int a, int b) {
+                return entries[a].size != entries[b].size
+                    ? entries[a].size > entries[b].size
+                    : entries[a].captured < entries[b].captured;
+            });
+            QVector<int> rank(total);
+            for(int r = 0; r < keeperOrder.count(); ++r) {
+                rank[keeperOrder[r]] = r;
+            }
+            QVector<bool> assigned(total, false);
+            QStringList duplicates;
+            int clusterCount = 0;
+            for(const int keeper : keeperOrder) {
+                if(assigned[keeper]) continue;
+                assigned[keeper] = true;
+                QVector<int> cluster;
+                for(const int i : tree.query(entries[keeper].hash, maxDistance)) {
+                    if(assigned[i]) continue;
+                    assigned[i] = true;
+                    cluster << i;
+                }
+                if(cluster.isEmpty()) continue;
+                std::sort(cluster.begin(), cluster.end(), [&](int a, int b) {
+                    return rank[a] < rank[b];
+                });
+                cluster.prepend(keeper);
+                _info() << QString("Cluster %1: %2 file(s)").arg(++clusterCount).arg(cluster.count());
+                for(const int i : cluster) {
+                    const bool keep = i == keeper;
+                    const QString captured = entries[i].captured > 0
+                        ? QDateTime::fromMSecsSinceEpoch(entries[i].captured).toString(Qt::ISODate)
+                        : QString("unknown date");
+                    _info() << QString("  %1 %2 (%3, %4, %5 bit(s) apart)").arg(keep ? "keep" : "dupe")
+                        .arg(fileList[i]).arg(DryRunPlan::formatBytes(entries[i].size)).arg(captured)
+                        .arg(ImageHash::distance(entries[keeper].hash, entries[i].hash));
+                    if(!keep) duplicates << fileList[i];
+                }
+            }
+            _info() << QString("Found %1 duplicate(s) in %2 cluster(s) among %3 image(s)")
+                .arg(duplicates.count()).arg(clusterCount).arg(total);
+            if(action == "list" || duplicates.isEmpty()) {
+                return 0;
+            }
+
+            QStringList problemFileList;
+            if(action == "move") {
+                problemFileList = multiFileOperation(duplicates,
+                    [&](const QString & filepath) {
+                        return QString("Moving duplicate %1").arg(filepath);
+                    },
+                    [&](const QString & filepath) {
+                        return moveFile(filepath, targetDirectory + filepath_ops::fileName(filepath), forceOverwrite, false);
+                    }
+                );
+            } else {
+                if(!forceOverwrite && !dryRun
+                    && !userConfirmation(QString("Remove %1 duplicate file(s)?").arg(duplicates.count()))) {
+                    _info() << "Removing duplicates aborted";
+                    return 0;
+                }
+                problemFileList = multiFileOperation(duplicates,
+                    [&](const QString & filepath) {
+                        return QString("Removing duplicate %1").arg(filepath);
+                    },
+                    removeFile
+                );
+            }
+            _info() << QString("Duplicates completed (%1 file(s) handled / %2 failed)!")
+                .arg(duplicates.count() - problemFileList.count()).arg(problemFileList.count());
+            return 0;
+        }
+    }),
     std::make_pair("transform", Task {
         [](QCommandLineParser & parser) {
             parser.clearPositionalArguments();
@@ -684,12 +1314,149 @@ static const QMap<QString, Task> tasks({
             parser.addOptions({
                 transformCopySuffixOption,
                 transformShrinkWidthOption, transformShrinkHeightOption,
-                transformFormatOption, transformQualityOption
+                transformFormatOption, transformQualityOption, transformMaxBytesOption
             });
         },
         [](QCommandLineParser & parser) {
-            QString fileNameSuffix = parser.value(transformCopySuffixOption);
-            abnormalExit("TODO - WIP", -999); // todo
+            parseIOSettings(parser);
+            using namespace lib_utils::io_ops;
+            using namespace lib_utils::image_transformations;
+            using namespace IOSettings;
+            const bool useSuffix = parser.isSet(transformCopySuffixOption);
+            const QString fileNameSuffix = parser.value(transformCopySuffixOption);
+            const auto positiveValue = [&](const QCommandLineOption & option, const QString & name) {
+                if(!parser.isSet(option)) {
+                    return 0;
+                }
+                bool ok;
+                const int value = parser.value(option).toInt(&ok);
+                if(!ok || value <= 0) {
+                    abnormalExit(QString("Invalid %1 \"%2\"").arg(name).arg(parser.value(option)), 3);
+                }
+                return value;
+            };
+            const int width = positiveValue(transformShrinkWidthOption, "width");
+            const int height = positiveValue(transformShrinkHeightOption, "height");
+            const QString format = parser.value(transformFormatOption).toLower();
+            if(!format.isEmpty() && !lib_utils::supportedFormats().contains(format)) {
+                abnormalExit(QString("Unsupported file format \"%1\"").arg(format), 3);
+            }
+            bool qualityOk;
+            const int quality = parser.value(transformQualityOption).toInt(&qualityOk);
+            if(!qualityOk || quality < 0 || quality > 100) {
+                abnormalExit(QString("Invalid quality \"%1\"").arg(parser.value(transformQualityOption)), 3);
+            }
+            const auto suffixedPath = [&](const QString & filepath, const QString & extension) {
+                const QFileInfo fi(filepath);
+                return filepath_ops::directoryPath(filepath) + fi.completeBaseName()
+                    + (useSuffix ? fileNameSuffix : QString()) + '.' + extension;
+            };
+            auto fileList = listFiles();
+            const int total = fileList.count();
+
+            if(!parser.isSet(transformMaxBytesOption)) {
+                auto problemFileList = multiFileOperation(fileList,
+                    [&](const QString & filepath) {
+                        return QString("Transforming %1").arg(filepath);
+                    },
+                    [&](const QString & filepath) {
+                        QString target = filepath;
+                        if(useSuffix) {
+                            target = suffixedPath(filepath, QFileInfo(filepath).suffix());
+                            if(!copyFile(filepath, target, forceOverwrite, false)) {
+                                return false;
+                            }
+                            if(dryRun) {
+                                return true;
+                            }
+                        }
+                        bool success = true;
+                        if(width > 0 && height > 0) {
+                            success = scaleToSize(target, width, height);
+                        } else if(width > 0) {
+                            success = scaleToWidth(target, width);
+                        } else if(height > 0) {
+                            success = scaleToHeight(target, height);
+                        }
+                        if(success && (!format.isEmpty() || parser.isSet(transformQualityOption))) {
+                            success = reformat(target, format.isEmpty() ? filepath_ops::fileExtension(target) : format, quality);
+                        }
+                        return success;
+                    }
+                );
+                _info() << QString("Transforming completed (%1 file(s) transformed / %2 failed)!")
+                    .arg(total - problemFileList.count()).arg(problemFileList.count());
+                return 0;
+            }
+
+            qint64 maxBytes;
+            if(!ByteBudgetEncoder::parseByteSize(parser.value(transformMaxBytesOption), maxBytes)) {
+                abnormalExit(QString("Invalid byte size \"%1\"").arg(parser.value(transformMaxBytesOption)), 3);
+            }
+            const int maxQuality = parser.isSet(transformQualityOption) ? quality : 95;
+            // overwrite decisions are taken up front, the workers must not ask for confirmation
+            QStringList problemFileList;
+            filter(fileList, [&](const QString & filepath) {
+                const QString target = suffixedPath(filepath, format.isEmpty() ? QFileInfo(filepath).suffix() : format);
+                if(!arePathsEqual(filepath, target) && isPathExistingFile(target) && !forceOverwrite) {
+                    _warn() << QString("Transforming file failed - target file already exists \"%1\"").arg(target);
+                    problemFileList << filepath;
+                    return false;
+                }
+                return true;
+            });
+            // re-encoding an image that already fits would only lose quality
+            int withinBudget = 0;
+            if(width <= 0 && height <= 0) {
+                filter(fileList, [&](const QString & filepath) {
+                    const QFileInfo fi(filepath);
+                    if((!format.isEmpty() && format != fi.suffix().toLower()) || fi.size() > maxBytes) {
+                        return true;
+                    }
+                    _info() << QString("Already within budget \"%1\"").arg(filepath);
+                    if(useSuffix && !copyFile(filepath, suffixedPath(filepath, fi.suffix()), forceOverwrite, false)) {
+                        problemFileList << filepath;
+                    } else {
+                        ++withinBudget;
+                    }
+                    return false;
+                });
+            }
+            _debug() << QString("Fitting %1 image(s) into %L2 bytes on %3 thread(s)")
+                .arg(fileList.count()).arg(maxBytes).arg(QThread::idealThreadCount());
+            const std::function<BudgetResult (const QString &)> job = [=](const QString & filepath) {
+                const QString extension = format.isEmpty() ? QFileInfo(filepath).suffix() : format;
+                const QString target = suffixedPath(filepath, extension);
+                auto result = fitToByteBudget(filepath, target, extension.toLower(), maxBytes, maxQuality, width, height);
+                // converted in place into another format, the original is replaced on the main thread
+                result.removeOriginal = result.success && !useSuffix && !arePathsEqual(filepath, target);
+                return result;
+            };
+            auto results = QtConcurrent::mapped(fileList, job);
+            const int count = fileList.count();
+            for(int i = 0; i < count; ++i) {
+                const int pos = i + 1;
+                _info() << progressMessage(pos, count, QString("Shrinking %1").arg(fileList[i]));
+                if(progressBar) drawProgressBar((pos-1)*1.0/count);
+                const auto result = results.resultAt(i);
+                if(result.success) {
+                    _debug() << result.message;
+                    if(result.removeOriginal) {
+                        _debug() << QString("Removing original \"%1\"").arg(fileList[i]);
+                        if(!removeFile(fileList[i])) {
+                            _warn() << QString("Removing original failed \"%1\"").arg(fileList[i]);
+                            problemFileList << fileList[i];
+                        }
+                    }
+                } else {
+                    _warn() << result.message;
+                    problemFileList << fileList[i];
+                }
+                if(progressBar) drawProgressBar(pos*1.0/count);
+            }
+            clearProgressBar();
+            _info() << QString("Shrinking completed (%1 file(s) shrunk / %2 already within budget / %3 failed)!")
+                .arg(total - withinBudget - problemFileList.count()).arg(withinBudget).arg(problemFileList.count());
             return 0;
         }
     })
@@ -714,6 +1481,12 @@ void initParserAndLogging(const QCoreApplication & app, QCommandLineParser & par
         abnormalExit("Invalid arguments: --verbose cannot be set at the same time with --quiet");
     }
     Logging::suppressWarnings = parser.isSet(suppressWarningsFlag);
+    // the task options are not registered yet, but an archive streamed to stdout
+    // must not get any log line in front of it, so look at the raw arguments
+    const QStringList arguments = app.arguments();
+    const int archiveIndex = arguments.indexOf(QString("--%1").arg(targetArchiveOption.names().first()));
+    Logging::useStderr = arguments.contains(QString("--%1=-").arg(targetArchiveOption.names().first()))
+        || (archiveIndex >= 0 && arguments.value(archiveIndex + 1) == "-");
 }
 
 void showSupportedFormats() {
@@ -725,6 +1498,16 @@ void showSupportedFormats() {
     }
 }
 
+void reportDryRun() {
+    using namespace IOSettings;
+    _info() << "Calibrating on a sample of the selected files...";
+    dryRunPlan.setPerFileOverhead(lib_utils::io_ops::operationDelay / 1000.0);
+    dryRunPlan.calibrate();
+    for(const QString & line : dryRunPlan.report()) {
+        _info() << line;
+    }
+}
+
 int main(int argc, char *argv[])
 {
     qInstallMessageHandler(VerbosityHandler);
@@ -765,6 +1548,10 @@ int main(int argc, char *argv[])
 	    parser.process(app);
         _debug() << QString("Starting task \"%1\"").arg(taskName);
     }
-    return task.taskHandler(parser);
+    const int exitCode = task.taskHandler(parser);
+    if(IOSettings::dryRun && !IOSettings::dryRunPlan.isEmpty()) {
+        reportDryRun();
+    }
+    return exitCode;
     // return app.exec();
 }
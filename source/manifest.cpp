@@ -0,0 +1,131 @@
+#include "manifest.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTextStream>
+
+const QString Manifest::fileName(".pscom-manifest");
+
+static const QString header("# pscom-cli manifest v1");
+
+Manifest::Manifest(const QString & directory)
+    : directory(directory), manifestPath(QDir(directory).filePath(fileName))
+{
+}
+
+bool Manifest::load()
+{
+    entries.clear();
+    QFile file(manifestPath);
+    if(!file.exists()) {
+        return true;
+    }
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return false;
+    }
+    QTextStream in(&file);
+    in.setCodec("UTF-8");
+    while(!in.atEnd()) {
+        const QString line = in.readLine();
+        if(line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+        // the path goes last and may contain tabs itself
+        const QStringList fields = line.split('\t');
+        if(fields.count() < 4) {
+            continue;
+        }
+        Entry entry;
+        entry.hash = fields[0].toLatin1();
+        entry.size = fields[1].toLongLong();
+        entry.modified = fields[2].toLongLong();
+        entries.insert(fields.mid(3).join('\t'), entry);
+    }
+    return true;
+}
+
+bool Manifest::save() const
+{
+    // written to a temporary file first, an interrupted run keeps the previous manifest
+    QSaveFile file(manifestPath);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return false;
+    }
+    QTextStream out(&file);
+    out.setCodec("UTF-8");
+    out << header << '\n';
+    for(auto i = entries.constBegin(); i != entries.constEnd(); ++i) {
+        out << line(i.key(), i.value());
+    }
+    out.flush();
+    return file.commit();
+}
+
+const QString & Manifest::path() const
+{
+    return manifestPath;
+}
+
+int Manifest::count() const
+{
+    return entries.count();
+}
+
+void Manifest::insert(const QString & filepath, const Entry & entry)
+{
+    entries.insert(relativeName(filepath), entry);
+}
+
+bool Manifest::append(const QString & filepath, const Entry & entry)
+{
+    const QString name = relativeName(filepath);
+    entries.insert(name, entry);
+    QFile file(manifestPath);
+    if(!file.open(QIODevice::ReadWrite | QIODevice::Text)) {
+        return false;
+    }
+    // one write per line, an interrupted run can only cut off the last one, which is then terminated
+    QString prefix;
+    if(file.size() == 0) {
+        prefix = header + '\n';
+    } else if(file.seek(file.size() - 1) && file.read(1) != "\n") {
+        prefix = "\n";
+    }
+    const QByteArray data = (prefix + line(name, entry)).toUtf8();
+    return file.seek(file.size()) && file.write(data) == data.size() && file.flush();
+}
+
+bool Manifest::isUnchanged(const QString & sourceFilepath, const QString & targetFilepath) const
+{
+    const auto entry = entries.constFind(relativeName(targetFilepath));
+    if(entry == entries.constEnd()) {
+        return false;
+    }
+    const QFileInfo source(sourceFilepath), target(targetFilepath);
+    return target.exists()
+        && source.size() == entry->size
+        && target.size() == entry->size
+        && source.lastModified().toMSecsSinceEpoch() == entry->modified;
+}
+
+Manifest::Entry Manifest::entryFor(const QString & filepath, const QByteArray & hash)
+{
+    const QFileInfo info(filepath);
+    Entry entry;
+    entry.size = info.size();
+    entry.modified = info.lastModified().toMSecsSinceEpoch();
+    entry.hash = hash;
+    return entry;
+}
+
+QString Manifest::relativeName(const QString & filepath) const
+{
+    return directory.relativeFilePath(filepath);
+}
+
+QString Manifest::line(const QString & name, const Entry & entry)
+{
+    return QString("%1\t%2\t%3\t%4\n").arg(QString::fromLatin1(entry.hash)).arg(entry.size).arg(entry.modified).arg(name);
+}
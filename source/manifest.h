@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QByteArray>
+#include <QDir>
+#include <QMap>
+#include <QString>
+
+/**
+ * @brief Manifest - records path, size, source modification time and SHA-256 of every
+ * verified copy inside the target directory, so later runs can skip unchanged files.
+ * Stored as tab separated lines "hash size modified path" with the path relative to the directory,
+ * appended lines override earlier ones for the same path.
+ */
+class Manifest {
+    public:
+        struct Entry {
+            qint64 size = -1;
+            qint64 modified = 0; // msecs since epoch of the source file
+            QByteArray hash; // hex encoded
+        };
+
+        static const QString fileName;
+
+        explicit Manifest(const QString & directory);
+
+        bool load();
+        bool save() const;
+        const QString & path() const;
+        int count() const;
+
+        void insert(const QString & filepath, const Entry & entry);
+        bool append(const QString & filepath, const Entry & entry); // insert and write the line immediately
+        bool isUnchanged(const QString & sourceFilepath, const QString & targetFilepath) const;
+
+        static Entry entryFor(const QString & filepath, const QByteArray & hash);
+
+    private:
+        QString relativeName(const QString & filepath) const;
+        static QString line(const QString & name, const Entry & entry);
+
+        QDir directory;
+        QString manifestPath;
+        QMap<QString, Entry> entries;
+};
@@ -7,6 +7,7 @@
 bool Logging::quiet = false;
 bool Logging::verbose = false;
 bool Logging::suppressWarnings = false;
+bool Logging::useStderr = false;
 
 void VerbosityHandler(QtMsgType type, const QMessageLogContext & /*context*/, const QString & message)
 {
@@ -16,7 +17,7 @@ void VerbosityHandler(QtMsgType type, const QMessageLogContext & /*context*/, co
 
     QString prefix("");
     bool noNewline = false;
-    auto stream = stdout;
+    auto stream = Logging::useStderr ? stderr : stdout;
 
     /**
      * qDebug for verbose and debug messages
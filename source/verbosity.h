@@ -7,6 +7,7 @@ class Logging {
         static bool quiet; // disables every output, fails silently
         static bool verbose; // enables qDebug output
         static bool suppressWarnings; // disables qWarning output
+        static bool useStderr; // moves every output to stderr, keeps stdout free for data
 };
 
 /**